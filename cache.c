@@ -0,0 +1,159 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+/* Persistent cache of values, such as connection parameters, that are
+   expensive to determine. Each cache file consists of lines of the
+   form key<TAB>value. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include "cache.h"
+
+/* Maximum length of a cache file line */
+#define CACHE_MXLN 512
+
+
+/*****************************************************************************
+ Construct the path of cache file name in path, of size psz, creating
+ the cache directory if necessary. The cache directory is rtkgps
+ within $XDG_CACHE_HOME, or within $HOME/.cache if XDG_CACHE_HOME is
+ not set.
+ *****************************************************************************/
+int cache_path(char *path, size_t psz, const char *name) {
+  const char *xdgp, *homp;
+  size_t n;
+
+  if ((xdgp = getenv("XDG_CACHE_HOME")) != NULL && xdgp[0] == '/')
+    n = snprintf(path, psz, "%s/rtkgps", xdgp);
+  else if ((homp = getenv("HOME")) != NULL && homp[0] != '\0') {
+    n = snprintf(path, psz, "%s/.cache", homp);
+    if (n < psz && mkdir(path, 0700) < 0 && errno != EEXIST)
+      return -1;
+    n = snprintf(path, psz, "%s/.cache/rtkgps", homp);
+  } else {
+    errno = ENOENT;
+    return -1;
+  }
+  if (n >= psz) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  if (mkdir(path, 0700) < 0 && errno != EEXIST)
+    return -1;
+
+  if (snprintf(path + n, psz - n, "/%s", name) >= (int)(psz - n)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Look up key in cache file name, copying the value into val, of size
+ vsz. Returns 1 if found, 0 if not found, and -1 on error.
+ *****************************************************************************/
+int cache_get(const char *name, const char *key, char *val, size_t vsz) {
+  char path[1024];
+  char ln[CACHE_MXLN];
+  FILE *fp;
+  size_t kl;
+  int fnd = 0;
+
+  if (cache_path(path, sizeof(path), name) < 0)
+    return -1;
+  if ((fp = fopen(path, "r")) == NULL)
+    return (errno == ENOENT)?0:-1;
+
+  kl = strlen(key);
+  while (!fnd && fgets(ln, sizeof(ln), fp) != NULL) {
+    if (strncmp(ln, key, kl) == 0 && ln[kl] == '\t') {
+      ln[strcspn(ln, "\n")] = '\0';
+      strncpy(val, ln + kl + 1, vsz - 1);
+      val[vsz - 1] = '\0';
+      fnd = 1;
+    }
+  }
+  fclose(fp);
+
+  return fnd;
+}
+
+
+/*****************************************************************************
+ Set the value of key in cache file name to val, replacing any
+ existing value. The file is replaced atomically, so that concurrent
+ readers never see a partially written cache.
+ *****************************************************************************/
+int cache_put(const char *name, const char *key, const char *val) {
+  char path[1024], tmpp[1040];
+  char ln[CACHE_MXLN];
+  FILE *ifp, *ofp;
+  size_t kl;
+  int rv = 0;
+
+  if (strpbrk(key, "\t\n") != NULL || strchr(val, '\n') != NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (cache_path(path, sizeof(path), name) < 0)
+    return -1;
+  sprintf(tmpp, "%s.%d", path, (int)getpid());
+  if ((ofp = fopen(tmpp, "w")) == NULL)
+    return -1;
+
+  kl = strlen(key);
+  if ((ifp = fopen(path, "r")) != NULL) {
+    while (fgets(ln, sizeof(ln), ifp) != NULL) {
+      if (!(strncmp(ln, key, kl) == 0 && ln[kl] == '\t'))
+	fputs(ln, ofp);
+    }
+    fclose(ifp);
+  }
+  fprintf(ofp, "%s\t%s\n", key, val);
+
+  if (ferror(ofp))
+    rv = -1;
+  if (fclose(ofp) != 0)
+    rv = -1;
+  if (rv == 0 && rename(tmpp, path) < 0)
+    rv = -1;
+  if (rv < 0)
+    unlink(tmpp);
+
+  return rv;
+}
+
+
+/*****************************************************************************
+ Remove cache file name, and with it all of its keys.
+ *****************************************************************************/
+int cache_clear(const char *name) {
+  char path[1024];
+
+  if (cache_path(path, sizeof(path), name) < 0)
+    return -1;
+  if (unlink(path) < 0 && errno != ENOENT)
+    return -1;
+
+  return 0;
+}
@@ -0,0 +1,28 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdio.h>
+
+int cache_path(char *path, size_t psz, const char *name);
+int cache_get(const char *name, const char *key, char *val, size_t vsz);
+int cache_put(const char *name, const char *key, const char *val);
+int cache_clear(const char *name);
+
+#endif
@@ -0,0 +1,217 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+/* Checkpoints of partially retrieved log files, so that an interrupted
+   retrieval can be resumed rather than restarted. A checkpoint file
+   consists of a single header line, identifying the log file by its
+   date, memory address and record type, followed by the fixes received
+   so far, in the binary representation of gps_fix_t. The header ends
+   with the number of fixes that have been written to the output file,
+   in a fixed width field so that it can be updated in place. */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include "ckpt.h"
+
+/* Checkpoint file format version, to be incremented if the
+   representation of gps_fix_t changes */
+#define CKPT_VRSN 2
+/* Width of the output fix count field of the header */
+#define CKPT_NSW 10
+
+
+/*****************************************************************************
+ Construct the identifying part of the checkpoint file header line for
+ log file lgfp in hdr, returning its length. The complete header line
+ consists of this followed by the output fix count field and a newline.
+ *****************************************************************************/
+static int ckpt_header(char *hdr, size_t hsz, const logfile_t *lgfp) {
+  return snprintf(hdr, hsz, "rtkgps checkpoint %d %8.8s %d %hd %u ",
+		  CKPT_VRSN, lgfp->date, lgfp->memp, lgfp->fxtyp,
+		  (unsigned int)sizeof(gps_fix_t));
+}
+
+
+/*****************************************************************************
+ Read the header of checkpoint stream fp, returning the number of fixes
+ recorded, or -1 if it is not a checkpoint of log file lgfp. The
+ number of fixes written to the output file is set in nsync.
+ *****************************************************************************/
+static int ckpt_read_header(FILE *fp, const logfile_t *lgfp, int *nsync) {
+  char hdr[128], ln[128];
+  struct stat st;
+  int hl, n = 0;
+
+  hl = ckpt_header(hdr, sizeof(hdr), lgfp);
+  /* A checkpoint of a different log file, such as one that has been
+     erased, is not used */
+  if (fgets(ln, sizeof(ln), fp) == NULL || strncmp(ln, hdr, hl) != 0 ||
+      sscanf(ln + hl, "%d", nsync) != 1 || *nsync < 0 ||
+      fstat(fileno(fp), &st) < 0)
+    return -1;
+  hl += CKPT_NSW + 1;
+  if (st.st_size > hl)
+    n = (st.st_size - hl)/(off_t)sizeof(gps_fix_t);
+
+  return n;
+}
+
+
+/*****************************************************************************
+ Open checkpoint file path for log file lgfp. If the file exists and
+ is a checkpoint of the same log file, the fixes it records are copied
+ into gfxp, and appended to by ckpt_append. Otherwise a new checkpoint
+ is created. Returns the number of fixes recovered, or -1 on error.
+ *****************************************************************************/
+int ckpt_open(checkpoint_t *ckp, const char *path, const logfile_t *lgfp,
+	      gps_fix_t *gfxp) {
+  char hdr[128];
+  long int hl;
+  int n, nsync;
+
+  ckp->fp = NULL;
+  ckp->nfix = 0;
+  ckp->nsync = 0;
+  if (strlen(path) >= sizeof(ckp->path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(ckp->path, path);
+  ckp->nsof = ckpt_header(hdr, sizeof(hdr), lgfp);
+  hl = ckp->nsof + CKPT_NSW + 1;
+
+  if ((ckp->fp = fopen(path, "r+")) != NULL) {
+    if ((n = ckpt_read_header(ckp->fp, lgfp, &nsync)) >= 0) {
+      if (n > lgfp->nfix)
+	n = lgfp->nfix;
+      if ((int)fread(gfxp, sizeof(gps_fix_t), n, ckp->fp) != n) {
+	fclose(ckp->fp);
+	ckp->fp = NULL;
+	return -1;
+      }
+      /* Remove any incompletely written fix, and fixes beyond the end
+	 of the log file */
+      if (fseek(ckp->fp, hl + n*sizeof(gps_fix_t), SEEK_SET) < 0 ||
+	  ftruncate(fileno(ckp->fp), hl + n*sizeof(gps_fix_t)) < 0) {
+	fclose(ckp->fp);
+	ckp->fp = NULL;
+	return -1;
+      }
+      ckp->nfix = n;
+      ckp->nsync = (nsync < n)?nsync:n;
+      return n;
+    }
+    fclose(ckp->fp);
+  } else if (errno != ENOENT)
+    return -1;
+
+  if ((ckp->fp = fopen(path, "w")) == NULL)
+    return -1;
+  if (fprintf(ckp->fp, "%s%*d\n", hdr, CKPT_NSW, 0) < 0 ||
+      fflush(ckp->fp) != 0) {
+    fclose(ckp->fp);
+    ckp->fp = NULL;
+    remove(path);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Return the number of fixes of log file lgfp that checkpoint file path
+ records as written to the output file, without opening the checkpoint
+ for update. Returns 0 if there is no checkpoint of the log file.
+ *****************************************************************************/
+int ckpt_synced(const char *path, const logfile_t *lgfp) {
+  FILE *fp;
+  int n, nsync;
+
+  if ((fp = fopen(path, "r")) == NULL)
+    return 0;
+  n = ckpt_read_header(fp, lgfp, &nsync);
+  fclose(fp);
+  /* The output file can only be extended if the checkpoint holds all
+     of the fixes written to it, and the log file has not shrunk */
+  if (n < 0 || nsync > n || nsync > lgfp->nfix)
+    return 0;
+
+  return nsync;
+}
+
+
+/*****************************************************************************
+ Append nfx fixes from gfxp to checkpoint ckp. The fixes are committed
+ to disk before returning, so that they survive a system failure.
+ *****************************************************************************/
+int ckpt_append(checkpoint_t *ckp, const gps_fix_t *gfxp, int nfx) {
+  if (ckp->fp == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  if ((int)fwrite(gfxp, sizeof(gps_fix_t), nfx, ckp->fp) != nfx ||
+      fflush(ckp->fp) != 0 || fsync(fileno(ckp->fp)) < 0)
+    return -1;
+  ckp->nfix += nfx;
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Record in checkpoint ckp that the first nsync fixes have been written
+ to the output file.
+ *****************************************************************************/
+int ckpt_sync(checkpoint_t *ckp, int nsync) {
+  char fld[CKPT_NSW + 2];
+
+  if (ckp->fp == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  sprintf(fld, "%*d", CKPT_NSW, nsync);
+  if (fflush(ckp->fp) != 0 ||
+      pwrite(fileno(ckp->fp), fld, CKPT_NSW, ckp->nsof) != CKPT_NSW ||
+      fsync(fileno(ckp->fp)) < 0)
+    return -1;
+  ckp->nsync = nsync;
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Close checkpoint ckp, removing the checkpoint file if rmflg is non-zero
+ (when the log file has been written in full).
+ *****************************************************************************/
+int ckpt_close(checkpoint_t *ckp, int rmflg) {
+  int rv = 0;
+
+  if (ckp->fp == NULL)
+    return 0;
+  if (fclose(ckp->fp) != 0)
+    rv = -1;
+  ckp->fp = NULL;
+  if (rmflg && remove(ckp->path) < 0)
+    rv = -1;
+
+  return rv;
+}
@@ -0,0 +1,40 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#ifndef _CKPT_H
+#define _CKPT_H
+
+#include <stdio.h>
+#include "rtkcom.h"
+
+/* Checkpoint of a partially retrieved log file */
+typedef struct {
+  FILE *fp;        /* checkpoint file stream, or NULL if not open */
+  char path[1024]; /* checkpoint file path */
+  int nfix;        /* number of fixes recorded */
+  int nsync;       /* number of fixes written to the output file */
+  long int nsof;   /* file offset of the output fix count */
+} checkpoint_t;
+
+int ckpt_open(checkpoint_t *ckp, const char *path, const logfile_t *lgfp,
+	      gps_fix_t *gfxp);
+int ckpt_synced(const char *path, const logfile_t *lgfp);
+int ckpt_append(checkpoint_t *ckp, const gps_fix_t *gfxp, int nfx);
+int ckpt_sync(checkpoint_t *ckp, int nsync);
+int ckpt_close(checkpoint_t *ckp, int rmflg);
+
+#endif
@@ -0,0 +1,141 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+/* Raw logger memory images, written by the dump command so that log
+   files can be split out and decoded without the logger. An image
+   consists of a text header, listing the logger memory details and the
+   metadata of each log file, followed by the records of each log file
+   in turn, exactly as they are stored in logger memory. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "dump.h"
+
+/* Image format version */
+#define DUMP_VRSN 1
+
+
+/*****************************************************************************
+ Write the header of an image of logger memory memp, holding nfile log
+ files with metadata lgflp, to stream fp. The records of each log file
+ are to be written to the stream, in order, after the header.
+ *****************************************************************************/
+int dump_write_header(FILE *fp, const memory_t *memp, short int nfile,
+		      const logfile_t *lgflp) {
+  short int n;
+
+  fprintf(fp, "RTKGPS DUMP %d\n", DUMP_VRSN);
+  fprintf(fp, "memory %lu %u %u\n", memp->nbytes, memp->sctrsz,
+	  memp->nmsctr);
+  fprintf(fp, "files %hd\n", nfile);
+  for (n = 0; n < nfile; n++)
+    fprintf(fp, "%hd %.8s %hd %d %d\n", n, lgflp[n].date, lgflp[n].fxtyp,
+	    lgflp[n].nfix, lgflp[n].memp);
+  fprintf(fp, "data\n");
+
+  return (ferror(fp))?-1:0;
+}
+
+
+/*****************************************************************************
+ Read the image in file path into dp, which should be released by
+ dump_free. Returns -1, with errno set, if the file can not be read or
+ is not a complete image.
+ *****************************************************************************/
+int dump_read(const char *path, dump_t *dp) {
+  FILE *fp;
+  char ln[128];
+  long int nb = 0;
+  short int n, fn;
+  int vrsn, err;
+
+  memset(dp, 0, sizeof(dump_t));
+  if ((fp = fopen(path, "r")) == NULL)
+    return -1;
+  if (fgets(ln, sizeof(ln), fp) == NULL ||
+      sscanf(ln, "RTKGPS DUMP %d", &vrsn) != 1 || vrsn != DUMP_VRSN ||
+      fgets(ln, sizeof(ln), fp) == NULL ||
+      sscanf(ln, "memory %lu %u %u", &dp->mem.nbytes, &dp->mem.sctrsz,
+	     &dp->mem.nmsctr) != 3 ||
+      fgets(ln, sizeof(ln), fp) == NULL ||
+      sscanf(ln, "files %hd", &dp->nfile) != 1 || dp->nfile < 0)
+    goto invalid;
+
+  if ((dp->lgflp = calloc(dp->nfile + 1, sizeof(logfile_t))) == NULL ||
+      (dp->offp = calloc(dp->nfile + 1, sizeof(long int))) == NULL)
+    goto error;
+  for (n = 0; n < dp->nfile; n++) {
+    logfile_t *lgfp = dp->lgflp + n;
+    if (fgets(ln, sizeof(ln), fp) == NULL ||
+	sscanf(ln, "%hd %8s %hd %d %d", &fn, lgfp->date, &lgfp->fxtyp,
+	       &lgfp->nfix, &lgfp->memp) != 5 || fn != n ||
+	fix_size(lgfp->fxtyp) == 0 || lgfp->nfix < 0)
+      goto invalid;
+    dp->offp[n] = nb;
+    nb += (long int)lgfp->nfix*fix_size(lgfp->fxtyp);
+  }
+  dp->offp[n] = nb;
+  if (fgets(ln, sizeof(ln), fp) == NULL || strcmp(ln, "data\n") != 0)
+    goto invalid;
+
+  /* The records must fill the remainder of the file exactly */
+  if ((dp->data = malloc(nb + 1)) == NULL)
+    goto error;
+  if ((long int)fread(dp->data, 1, nb + 1, fp) != nb) {
+    if (ferror(fp))
+      goto error;
+    goto invalid;
+  }
+  fclose(fp);
+
+  return 0;
+
+ invalid:
+  errno = EINVAL;
+ error:
+  err = errno;
+  fclose(fp);
+  dump_free(dp);
+  errno = err;
+  return -1;
+}
+
+
+/*****************************************************************************
+ Decode the records of log file filen of image dp into gfxp, returning
+ the number of fixes. Warnings are passed to session sp.
+ *****************************************************************************/
+int dump_file_fixes(rtk_session_t *sp, const dump_t *dp, short int filen,
+		    gps_fix_t *gfxp) {
+  const logfile_t *lgfp = dp->lgflp + filen;
+
+  fix_decode(sp, dp->data + dp->offp[filen], lgfp->fxtyp, lgfp->nfix, gfxp);
+
+  return lgfp->nfix;
+}
+
+
+/*****************************************************************************
+ Release the memory allocated for image dp.
+ *****************************************************************************/
+void dump_free(dump_t *dp) {
+  free(dp->lgflp);
+  free(dp->offp);
+  free(dp->data);
+  memset(dp, 0, sizeof(dump_t));
+}
@@ -0,0 +1,42 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#ifndef _DUMP_H
+#define _DUMP_H
+
+#include <stdio.h>
+#include "rtkcom.h"
+
+/* Raw image of logger memory, consisting of the records of each log
+   file as stored in logger memory, together with the memory details
+   and log file metadata needed to decode them */
+typedef struct {
+  memory_t mem;       /* logger memory details */
+  short int nfile;    /* number of log files */
+  logfile_t *lgflp;   /* metadata of each log file */
+  long int *offp;     /* offset of the records of each log file in data */
+  char *data;         /* log file records */
+} dump_t;
+
+int dump_write_header(FILE *fp, const memory_t *memp, short int nfile,
+		      const logfile_t *lgflp);
+int dump_read(const char *path, dump_t *dp);
+int dump_file_fixes(rtk_session_t *sp, const dump_t *dp, short int filen,
+		    gps_fix_t *gfxp);
+void dump_free(dump_t *dp);
+
+#endif
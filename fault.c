@@ -0,0 +1,339 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include "serial.h"
+#include "fault.h"
+
+/* Maximum length of a $LOG102 sentence */
+#define FAULT_MXSNT (11 + 255 + 5)
+
+
+typedef struct {
+  uint32_t tdrop, tflip, tdup, tswap, tdly; /* probability thresholds */
+  long int dlyms;         /* duration of latency spikes in ms */
+  uint64_t rng;           /* random number generator state */
+  char raw[TRANSPORT_IBSZ]; /* input not yet processed */
+  size_t rawn;
+  char out[2*TRANSPORT_IBSZ + FAULT_MXSNT]; /* input ready for delivery */
+  size_t outrp, outn;
+  char held[FAULT_MXSNT]; /* sentence held back for reordering */
+  size_t heldn;
+  struct timespec hold;   /* delivery suspended until this time */
+  fault_stats_t st;
+} fault_t;
+
+
+/*****************************************************************************
+ Return a pseudo-random 32 bit value. A private xorshift generator is
+ used so that fault sequences are reproducible across platforms.
+ *****************************************************************************/
+static uint32_t fault_rand(fault_t *fp) {
+  fp->rng ^= fp->rng >> 12;
+  fp->rng ^= fp->rng << 25;
+  fp->rng ^= fp->rng >> 27;
+  return (fp->rng * 2685821657736338717ULL) >> 32;
+}
+
+
+/*****************************************************************************
+ Return non-zero with probability corresponding to threshold thr.
+ *****************************************************************************/
+static int fault_occurs(fault_t *fp, uint32_t thr) {
+  return thr > 0 && fault_rand(fp) < thr;
+}
+
+
+/*****************************************************************************
+ Append bsz bytes of buf to the delivery buffer, dropping bytes and
+ flipping bits at the configured rates.
+ *****************************************************************************/
+static void fault_bytes(fault_t *fp, const char *buf, size_t bsz) {
+  size_t n;
+  char c;
+
+  for (n = 0; n < bsz; n++) {
+    if (fault_occurs(fp, fp->tdrop)) {
+      fp->st.ndrop++;
+      continue;
+    }
+    c = buf[n];
+    if (fault_occurs(fp, fp->tflip)) {
+      c ^= 1 << (fault_rand(fp) & 7);
+      fp->st.nflip++;
+    }
+    fp->out[fp->outn++] = c;
+  }
+}
+
+
+/*****************************************************************************
+ Append $LOG102 sentence snt of length sln to the delivery buffer,
+ duplicating it or swapping it with the following sentence at the
+ configured rates.
+ *****************************************************************************/
+static void fault_sentence(fault_t *fp, const char *snt, size_t sln) {
+  if (fp->heldn > 0) {
+    fault_bytes(fp, snt, sln);
+    fault_bytes(fp, fp->held, fp->heldn);
+    fp->heldn = 0;
+  } else if (fault_occurs(fp, fp->tswap)) {
+    memcpy(fp->held, snt, sln);
+    fp->heldn = sln;
+    fp->st.nswap++;
+  } else {
+    fault_bytes(fp, snt, sln);
+    if (fault_occurs(fp, fp->tdup)) {
+      fault_bytes(fp, snt, sln);
+      fp->st.ndup++;
+    }
+  }
+}
+
+
+/*****************************************************************************
+ Move input from the raw buffer to the delivery buffer. Bytes that may
+ be part of an incomplete $LOG102 sentence are retained unless flush
+ is non-zero.
+ *****************************************************************************/
+static void fault_process(fault_t *fp, int flush) {
+  const char *cp;
+  size_t n;
+
+  while (fp->rawn > 0) {
+    if (fp->rawn >= 8 && memcmp(fp->raw, "$LOG102,", 8) == 0) {
+      if (fp->rawn < 11 ||
+	  fp->rawn < (n = 11 + (unsigned char)fp->raw[10] + 5))
+	break;
+      fault_sentence(fp, fp->raw, n);
+    } else if (fp->rawn < 8 && memcmp(fp->raw, "$LOG102,", fp->rawn) == 0) {
+      break;
+    } else {
+      cp = memchr(fp->raw + 1, '$', fp->rawn - 1);
+      n = (cp == NULL)?fp->rawn:(size_t)(cp - fp->raw);
+      fault_bytes(fp, fp->raw, n);
+    }
+    fp->rawn -= n;
+    memmove(fp->raw, fp->raw + n, fp->rawn);
+  }
+
+  if (flush) {
+    fault_bytes(fp, fp->raw, fp->rawn);
+    fp->rawn = 0;
+    fault_bytes(fp, fp->held, fp->heldn);
+    fp->heldn = 0;
+  }
+}
+
+
+/*****************************************************************************
+ Wait until deadline dlp for input, including any latency spike. If
+ the wrapped transport times out, retained input is released.
+ *****************************************************************************/
+static int fault_wait(transport_t *tp, const struct timespec *dlp) {
+  fault_t *fp = tp->priv;
+  int wt;
+
+  if (fp->outn > fp->outrp) {
+    if (deadline_remaining(&fp->hold) == 0)
+      return 1;
+    deadline_sleep((deadline_remaining(&fp->hold) < deadline_remaining(dlp))?
+		   &fp->hold:dlp);
+    return (deadline_remaining(&fp->hold) == 0)?1:0;
+  }
+
+  wt = tp->inner->ops->wait(tp->inner, dlp);
+  if (wt == 0 && (fp->rawn > 0 || fp->heldn > 0)) {
+    fp->outrp = fp->outn = 0;
+    fault_process(fp, 1);
+    return (fp->outn > 0)?1:0;
+  }
+
+  return wt;
+}
+
+
+/*****************************************************************************
+ Read at most bsz bytes of input, with faults injected.
+ *****************************************************************************/
+static ssize_t fault_read(transport_t *tp, char *buf, size_t bsz) {
+  fault_t *fp = tp->priv;
+  ssize_t b;
+  size_t n;
+
+  if (fp->outn == fp->outrp) {
+    fp->outrp = fp->outn = 0;
+    b = tp->inner->ops->read(tp->inner, fp->raw + fp->rawn,
+			     TRANSPORT_IBSZ - fp->rawn);
+    tp->eof = tp->inner->eof;
+    if (b < 0)
+      return b;
+    fp->st.nrcv += b;
+    fp->rawn += b;
+    fault_process(fp, tp->eof);
+    if (fp->outn > 0 && fault_occurs(fp, fp->tdly)) {
+      deadline_set(&fp->hold, fp->dlyms);
+      fp->st.ndly++;
+    }
+  }
+  if (fp->outn == fp->outrp || deadline_remaining(&fp->hold) > 0)
+    return 0;
+
+  n = fp->outn - fp->outrp;
+  if (n > bsz)
+    n = bsz;
+  memcpy(buf, fp->out + fp->outrp, n);
+  fp->outrp += n;
+  fp->st.ndlv += n;
+
+  return n;
+}
+
+
+/*****************************************************************************
+ Write to the wrapped transport without modification.
+ *****************************************************************************/
+static ssize_t fault_write(transport_t *tp, const char *buf, size_t bsz) {
+  return tp->inner->ops->write(tp->inner, buf, bsz);
+}
+
+
+/*****************************************************************************
+ Free fault injection state. The wrapped transport is closed by
+ transport_close.
+ *****************************************************************************/
+static int fault_close(transport_t *tp) {
+  free(tp->priv);
+  return 0;
+}
+
+
+/*****************************************************************************
+ Change the line speed of the wrapped transport.
+ *****************************************************************************/
+static int fault_speed(transport_t *tp, unsigned int speed) {
+  return transport_speed(tp->inner, speed);
+}
+
+
+/* The input watermark is not passed on to the wrapped transport, since
+   dropped bytes would leave waits blocked until their deadlines */
+static const transport_ops_t fault_transport = {
+  "fault", NULL, fault_wait, fault_read, fault_write, fault_close,
+  fault_speed, NULL
+};
+
+
+/*****************************************************************************
+ Convert probability p to a threshold for fault_occurs.
+ *****************************************************************************/
+static uint32_t fault_threshold(double p) {
+  if (p <= 0.0)
+    return 0;
+  if (p >= 1.0)
+    return 0xffffffffU;
+  return (uint32_t)(p * 4294967296.0);
+}
+
+
+/*****************************************************************************
+ Inject faults into the input from transport tp according to fault
+ profile string prfs, a comma separated list of drop=<p>, flip=<p>,
+ dup=<p>, swap=<p>, delay=<p>:<ms>, and seed=<n>. Byte drop and bit
+ flip probabilities apply per byte, duplication and swap probabilities
+ per $LOG102 sentence, and delay probability per read. Returns a
+ transport wrapping tp, or NULL, with errno set, on failure.
+ *****************************************************************************/
+transport_t *fault_inject(transport_t *tp, const char *prfs) {
+  fault_t *fp;
+  transport_t *ftp;
+  char *str, *tok, *sp;
+  double p;
+  unsigned long seed = 1;
+  int vld = 1;
+
+  if ((fp = malloc(sizeof(fault_t))) == NULL)
+    return NULL;
+  memset(fp, 0, sizeof(fault_t));
+  if ((str = strdup(prfs)) == NULL) {
+    free(fp);
+    return NULL;
+  }
+
+  for (tok = strtok_r(str, ",", &sp); tok != NULL && vld;
+       tok = strtok_r(NULL, ",", &sp)) {
+    if (sscanf(tok, "drop=%lf", &p) == 1)
+      fp->tdrop = fault_threshold(p);
+    else if (sscanf(tok, "flip=%lf", &p) == 1)
+      fp->tflip = fault_threshold(p);
+    else if (sscanf(tok, "dup=%lf", &p) == 1)
+      fp->tdup = fault_threshold(p);
+    else if (sscanf(tok, "swap=%lf", &p) == 1)
+      fp->tswap = fault_threshold(p);
+    else if (sscanf(tok, "delay=%lf:%ld", &p, &fp->dlyms) == 2 &&
+	     fp->dlyms >= 0)
+      fp->tdly = fault_threshold(p);
+    else if (sscanf(tok, "seed=%lu", &seed) != 1)
+      vld = 0;
+  }
+  free(str);
+  if (!vld) {
+    free(fp);
+    errno = EINVAL;
+    return NULL;
+  }
+  /* The generator state must be non-zero */
+  fp->rng = 0x9e3779b97f4a7c15ULL ^ seed;
+
+  if ((ftp = transport_wrap(&fault_transport, tp, fp)) == NULL) {
+    free(fp);
+    return NULL;
+  }
+
+  return ftp;
+}
+
+
+/*****************************************************************************
+ Return fault injection statistics for tp, or for the transport that
+ it wraps, or NULL if there is no fault injection transport.
+ *****************************************************************************/
+const fault_stats_t *fault_stats(const transport_t *tp) {
+  for (; tp != NULL; tp = tp->inner) {
+    if (tp->ops == &fault_transport)
+      return &((fault_t *)tp->priv)->st;
+  }
+  return NULL;
+}
+
+
+/*****************************************************************************
+ Print fault injection statistics for tp to the indicated stream.
+ *****************************************************************************/
+void fault_stats_print(FILE *stream, const transport_t *tp) {
+  const fault_stats_t *stp;
+
+  if ((stp = fault_stats(tp)) == NULL)
+    return;
+  fprintf(stream, "Fault injection: %lu bytes received, %lu delivered, "
+	  "%lu dropped, %lu flipped,\n  %lu sentences duplicated, "
+	  "%lu reordered, %lu latency spikes\n", stp->nrcv, stp->ndlv,
+	  stp->ndrop, stp->nflip, stp->ndup, stp->nswap, stp->ndly);
+}
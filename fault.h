@@ -0,0 +1,38 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#ifndef _FAULT_H
+#define _FAULT_H
+
+#include <stdio.h>
+#include "transport.h"
+
+typedef struct {
+  unsigned long nrcv;   /* bytes received from wrapped transport */
+  unsigned long ndlv;   /* bytes delivered */
+  unsigned long ndrop;  /* bytes dropped */
+  unsigned long nflip;  /* bytes with a flipped bit */
+  unsigned long ndup;   /* duplicated $LOG102 sentences */
+  unsigned long nswap;  /* reordered $LOG102 sentence pairs */
+  unsigned long ndly;   /* latency spikes */
+} fault_stats_t;
+
+transport_t *fault_inject(transport_t *tp, const char *prfs);
+const fault_stats_t *fault_stats(const transport_t *tp);
+void fault_stats_print(FILE *stream, const transport_t *tp);
+
+#endif
@@ -11,7 +11,7 @@
     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
     General Public License for more details.
 
-    Most recent modification: 4 February 2012
+    Most recent modification: 17 October 2026
 
 ******************************************************************************/
 
@@ -74,14 +74,20 @@ void print_hdr_nmea(FILE *stream, const char* btas) {
  *****************************************************************************/
 void print_log_nmea(FILE *stream, const logfile_t *lfp, const gps_fix_t *fxp,
 		    const float *gcp) {
-  int n;
+  int n, j, k, m, gl, nsv, nsnt;
   char *pgga;
   char gga[256];
   char *prmc;
   char rmc[256];
+  char *pgsv;
+  char gsv[256];
+  char *pdst;
+  char dst[128];
   char time[32];
   char alt[32];
   char vel[16];
+  char sat[32];
+  char crs[16];
   char ltd, lnd;
   double lat, lon;
 
@@ -104,18 +110,59 @@ void print_log_nmea(FILE *stream, const logfile_t *lfp, const gps_fix_t *fxp,
       sprintf(vel, "%06.2f", 0.539956803f*fxp[n].vel);
     else
       vel[0] = '\0';
+    if (lfp->fxtyp > 3) {
+      sprintf(sat, "%02d,%.1f", fxp[n].nfix >> 4, fxp[n].hdop/100.0);
+      sprintf(crs, "%.2f", fxp[n].angle);
+    } else {
+      sprintf(sat, ",");
+      crs[0] = '\0';
+    }
 
     pgga = (fxp[n].unkwn == 0)?"$GPGGA":"$PRTK,BADFIX,GPGGA";
     prmc = (fxp[n].unkwn == 0)?"$GPRMC":"$PRTK,BADFIX,GPRMC";
+    pgsv = (fxp[n].unkwn == 0)?"$GPGSV":"$PRTK,BADFIX,GPGSV";
+    pdst = (fxp[n].unkwn == 0)?"$RTDIST":"$PRTK,BADFIX,RTDIST";
 
-    sprintf(gga, "%s,%s,%09.4f,%c,%010.4f,%c,1,,,%s,,*", 
-	    pgga, time, lat, ltd, lon, lnd, alt);
+    sprintf(gga, "%s,%s,%09.4f,%c,%010.4f,%c,1,%s,%s,,*", 
+	    pgga, time, lat, ltd, lon, lnd, sat, alt);
     fprintf(stream, "%s%02X\r\n", gga, string_checksum(gga));
 
-    sprintf(rmc, "%s,%s,A,%09.4f,%c,%010.4f,%c,%s,,%2.2s%2.2s%2.2s,,,*",
-	    prmc, time, lat, ltd, lon, lnd, vel, lfp->date+6, lfp->date+4, 
-	    lfp->date+2);
+    /* Satellites in view, four to a sentence, from the satellite
+       number and signal strength pairs with a non-zero number. The
+       elevation and azimuth are not recorded. */
+    if (lfp->fxtyp > 3) {
+      for (nsv = 0, k = 0; k < 12; k++)
+	if (fxp[n].sat[2*k] != 0)
+	  nsv++;
+      nsnt = (nsv + 3)/4;
+      for (m = 0, k = 0; m < nsnt; m++) {
+	gl = sprintf(gsv, "%s,%d,%d,%02d", pgsv, nsnt, m + 1, nsv);
+	for (j = 0; j < 4 && k < 12; k++) {
+	  if (fxp[n].sat[2*k] != 0) {
+	    gl += sprintf(gsv + gl, ",%02d,,,%02d", fxp[n].sat[2*k],
+			  fxp[n].sat[2*k+1]);
+	    j++;
+	  }
+	}
+	strcpy(gsv + gl, "*");
+	fprintf(stream, "%s%02X\r\n", gsv, string_checksum(gsv));
+      }
+    }
+
+    sprintf(rmc, "%s,%s,A,%09.4f,%c,%010.4f,%c,%s,%s,%2.2s%2.2s%2.2s,,,*",
+	    prmc, time, lat, ltd, lon, lnd, vel, crs, lfp->date+6,
+	    lfp->date+4, lfp->date+2);
     fprintf(stream, "%s%02X\r\n", rmc, string_checksum(rmc));
+
+    /* Distance travelled, with the dilution of precision if recorded */
+    if (lfp->fxtyp > 3)
+      sprintf(dst, "%s,A,3,%.1f,%.1f,%.1f,%u*", pdst, fxp[n].pdop/100.0,
+	      fxp[n].hdop/100.0, fxp[n].vdop/100.0,
+	      (unsigned int)fxp[n].dist);
+    else if (lfp->fxtyp > 2)
+      sprintf(dst, "%s,A,3,,,,%u*", pdst, (unsigned int)fxp[n].dist);
+    if (lfp->fxtyp > 2)
+      fprintf(stream, "%s%02X\r\n", dst, string_checksum(dst));
   }
 }
 
@@ -148,6 +195,12 @@ void print_log_native(FILE *stream, const logfile_t *lfp,
     }
     if (lfp->fxtyp > 1)
       fprintf(stream, ",%+.8e", fxp[n].vel);
+    if (lfp->fxtyp > 2)
+      fprintf(stream, ",%u", (unsigned int)fxp[n].dist);
+    if (lfp->fxtyp > 3)
+      fprintf(stream, ",%d,%.2f,%.2f,%.2f,%+.8e", fxp[n].nfix >> 4,
+	      fxp[n].hdop/100.0, fxp[n].pdop/100.0, fxp[n].vdop/100.0,
+	      fxp[n].angle);
     fprintf(stream, "\n");
   }
 }
@@ -0,0 +1,191 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+/* Cache of logger metadata that is expensive to query, consisting of
+   the metadata and start time of each complete log file, and the
+   firmware and memory details. The cache for each logger is held in
+   a separate cache file, named after the device or bluetooth address
+   identifying the logger, and is discarded when the first fix in the
+   log changes (when log memory is erased or overwritten) or the number
+   of log files decreases. The metadata of the last log file, which is
+   still being extended, is never cached. */
+
+#include <string.h>
+#include <ctype.h>
+#include "cache.h"
+#include "logcache.h"
+
+
+/*****************************************************************************
+ Open the cache for the logger identified by devid, with log boundary
+ lgbp and nfile log files, discarding it if the log has changed since
+ it was last used. If the cache can not be used, caching is disabled
+ and -1 is returned.
+ *****************************************************************************/
+int logcache_open(logcache_t *lcp, const char *devid,
+		  const log_bndry_t *lgbp, short int nfile) {
+  char val[64], date[9], time[7];
+  short int nc;
+  size_t n;
+
+  lcp->nfile = nfile;
+  strcpy(lcp->name, "logs-");
+  for (n = 5; *devid != '\0' && n < sizeof(lcp->name) - 1; devid++, n++)
+    lcp->name[n] = (isalnum((unsigned char)*devid))?*devid:'_';
+  lcp->name[n] = '\0';
+
+  if (cache_get(lcp->name, "boundary", val, sizeof(val)) > 0 &&
+      sscanf(val, "%8s %6s %hd", date, time, &nc) == 3 &&
+      strcmp(date, lgbp->first.date) == 0 &&
+      strcmp(time, lgbp->first.time) == 0 && nc <= nfile) {
+    if (nc == nfile)
+      return 0;
+  } else if (cache_clear(lcp->name) < 0) {
+    lcp->name[0] = '\0';
+    return -1;
+  }
+
+  sprintf(val, "%s %s %hd", lgbp->first.date, lgbp->first.time, nfile);
+  if (cache_put(lcp->name, "boundary", val) < 0) {
+    lcp->name[0] = '\0';
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Get the cached metadata for log file filen into lgfp, and its start
+ time into time (of size 7), if not NULL, or an empty string if the
+ start time is not known. Returns 1 if found, or 0 otherwise.
+ *****************************************************************************/
+int logcache_file_get(const logcache_t *lcp, short int filen,
+		      logfile_t *lgfp, char *time) {
+  char key[16], val[64], tm[8];
+
+  if (lcp->name[0] == '\0' || filen >= lcp->nfile - 1)
+    return 0;
+  sprintf(key, "%hd", filen);
+  if (cache_get(lcp->name, key, val, sizeof(val)) <= 0 ||
+      sscanf(val, "%8s %hd %d %d %7s", lgfp->date, &lgfp->fxtyp,
+	     &lgfp->nfix, &lgfp->memp, tm) != 5)
+    return 0;
+  if (time != NULL) {
+    if (strlen(tm) == 6)
+      strcpy(time, tm);
+    else
+      time[0] = '\0';
+  }
+
+  return 1;
+}
+
+
+/*****************************************************************************
+ Cache metadata lgfp and start time (or NULL if not known) of log file
+ filen, if the log file is complete.
+ *****************************************************************************/
+int logcache_file_put(const logcache_t *lcp, short int filen,
+		      const logfile_t *lgfp, const char *time) {
+  char key[16], val[64];
+
+  if (lcp->name[0] == '\0' || filen >= lcp->nfile - 1)
+    return 0;
+  sprintf(key, "%hd", filen);
+  sprintf(val, "%.8s %hd %d %d %.6s", lgfp->date, lgfp->fxtyp, lgfp->nfix,
+	  lgfp->memp, (time != NULL && time[0] != '\0')?time:"-");
+
+  return cache_put(lcp->name, key, val);
+}
+
+
+/*****************************************************************************
+ Get the cached firmware information into frmp. Returns 1 if found, or
+ 0 otherwise.
+ *****************************************************************************/
+int logcache_firmware_get(const logcache_t *lcp, firmware_t *frmp) {
+  char val[4*64+4];
+  char *fld[4], *cp;
+  int n;
+
+  if (lcp->name[0] == '\0' ||
+      cache_get(lcp->name, "firmware", val, sizeof(val)) <= 0)
+    return 0;
+  /* Fields are separated by tabs, since they may contain spaces */
+  for (cp = val, n = 0; n < 4; n++) {
+    fld[n] = cp;
+    if ((cp = strchr(cp, '\t')) == NULL && n < 3)
+      return 0;
+    if (cp != NULL)
+      *cp++ = '\0';
+  }
+  strcpy(frmp->vrsnr, fld[0]);
+  strcpy(frmp->frmwr, fld[1]);
+  strcpy(frmp->dflbd, fld[2]);
+  strcpy(frmp->drvrv, fld[3]);
+
+  return 1;
+}
+
+
+/*****************************************************************************
+ Cache firmware information frmp.
+ *****************************************************************************/
+int logcache_firmware_put(const logcache_t *lcp, const firmware_t *frmp) {
+  char val[4*64+4];
+
+  if (lcp->name[0] == '\0' || strchr(frmp->vrsnr, '\t') != NULL ||
+      strchr(frmp->frmwr, '\t') != NULL || strchr(frmp->dflbd, '\t') != NULL ||
+      strchr(frmp->drvrv, '\t') != NULL)
+    return 0;
+  sprintf(val, "%.63s\t%.63s\t%.63s\t%.63s", frmp->vrsnr, frmp->frmwr,
+	  frmp->dflbd, frmp->drvrv);
+
+  return cache_put(lcp->name, "firmware", val);
+}
+
+
+/*****************************************************************************
+ Get the cached memory details into memp. Returns 1 if found, or 0
+ otherwise.
+ *****************************************************************************/
+int logcache_memory_get(const logcache_t *lcp, memory_t *memp) {
+  char val[64];
+
+  if (lcp->name[0] == '\0' ||
+      cache_get(lcp->name, "memory", val, sizeof(val)) <= 0 ||
+      sscanf(val, "%lu %u %u", &memp->nbytes, &memp->sctrsz,
+	     &memp->nmsctr) != 3)
+    return 0;
+
+  return 1;
+}
+
+
+/*****************************************************************************
+ Cache memory details memp.
+ *****************************************************************************/
+int logcache_memory_put(const logcache_t *lcp, const memory_t *memp) {
+  char val[64];
+
+  if (lcp->name[0] == '\0')
+    return 0;
+  sprintf(val, "%lu %u %u", memp->nbytes, memp->sctrsz, memp->nmsctr);
+
+  return cache_put(lcp->name, "memory", val);
+}
@@ -0,0 +1,40 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#ifndef _LOGCACHE_H
+#define _LOGCACHE_H
+
+#include "rtkcom.h"
+
+/* Cache of log file metadata for a single logger */
+typedef struct {
+  char name[256];  /* cache file name, or empty if caching is disabled */
+  short int nfile; /* number of log files on the logger */
+} logcache_t;
+
+int logcache_open(logcache_t *lcp, const char *devid,
+		  const log_bndry_t *lgbp, short int nfile);
+int logcache_file_get(const logcache_t *lcp, short int filen,
+		      logfile_t *lgfp, char *time);
+int logcache_file_put(const logcache_t *lcp, short int filen,
+		      const logfile_t *lgfp, const char *time);
+int logcache_firmware_get(const logcache_t *lcp, firmware_t *frmp);
+int logcache_firmware_put(const logcache_t *lcp, const firmware_t *frmp);
+int logcache_memory_get(const logcache_t *lcp, memory_t *memp);
+int logcache_memory_put(const logcache_t *lcp, const memory_t *memp);
+
+#endif
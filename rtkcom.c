@@ -11,7 +11,7 @@
     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
     General Public License for more details.
 
-    Most recent modification: 20 February 2010
+    Most recent modification: 17 October 2026
 
 ******************************************************************************/
 
@@ -25,21 +25,85 @@
 #include <math.h>
 #include "rtkcom.h"
 
-void (*gdpfp)(unsigned short, unsigned short) = NULL;
+/* Bounds, in ms, on timeouts derived from measured response times */
+#define RTT_MNTMT 500
+#define RTT_MXTMT 8000
+/* Minimum timeout, in ms, for the response to a command that writes
+   to logger memory, which may take much longer than other commands */
+#define CMD_MNTMT 2000
+/* Maximum gap, in ms, between sentences of a multi-sentence response */
+#define RSP_IDLE 250
+/* Bounds, in bytes, on the size of log data requests. The upper bound
+   keeps the number of sentences in a response well below the 256 that
+   can be distinguished by the sentence index. */
+#define XFER_MNRQ 512
+#define XFER_MXRQ 16384
+/* Maximum number of consecutive failed log data requests */
+#define XFER_MXFAIL 8
+/* Maximum number of failed log data requests awaiting repetition */
+#define XFER_MXRTRY (2*XFER_MXWIN)
+/* Size, in bytes, of the buffer holding raw log data records until
+   all of the records preceding them have been received. Requests are
+   not sent beyond its end, so that it bounds the memory used however
+   much data is requested. */
+#define XFER_RAWSZ (4*XFER_MXWIN*XFER_MXRQ)
+/* Maximum length of a $LOG102 sentence */
+#define LOG102_MXLEN (11 + 255 + 5)
+
+/* State of the receipt of log data responses. The last sentence
+   accepted is kept, across responses, so that a duplicate of it can
+   be recognised and discarded, including a duplicate of the last
+   sentence of the previous response. */
+typedef struct {
+  int rsi;                /* index of the next sentence expected */
+  int nfx;                /* fixes received in the current response */
+  int ndup;               /* duplicate sentences discarded */
+  int lsl;                /* length of the last sentence, or 0 */
+  char ls[LOG102_MXLEN];  /* last sentence accepted */
+} data_rsp_t;
 
-rcerror_t rcerrno = RCERROR_NULL;
-int rcerrln = -1;
-void (*gcwrnfp)(const char *, int, const char *) = NULL;
+
+/*****************************************************************************
+ Create a session for the logger connected by transport tp, which is
+ closed with the session. The transport may be NULL for a session that
+ only decodes log data. Returns NULL, with errno set, on failure.
+ *****************************************************************************/
+rtk_session_t *rtk_session_open(transport_t *tp) {
+  rtk_session_t *sp;
+
+  if ((sp = calloc(1, sizeof(rtk_session_t))) == NULL)
+    return NULL;
+  sp->tp = tp;
+  sp->rcerrno = RCERROR_NULL;
+  sp->rcerrln = -1;
+
+  return sp;
+}
 
 
 /*****************************************************************************
- Return the error message string corresponding to the error number argument.
+ Close session sp and its transport.
  *****************************************************************************/
-const char *gcstrerror(rcerror_t rcerr) {
+int rtk_session_close(rtk_session_t *sp) {
+  int rc = 0;
+
+  if (sp->tp != NULL)
+    rc = transport_close(sp->tp);
+  free(sp);
+
+  return rc;
+}
+
+
+/*****************************************************************************
+ Return the error message string corresponding to the last error in
+ session sp.
+ *****************************************************************************/
+const char *gcstrerror(rtk_session_t *sp) {
   char *errmsg = "\0";
 
-  switch (rcerr) {
-  case RCERROR_SYS:  errmsg = strerror(rcerr);
+  switch (sp->rcerrno) {
+  case RCERROR_SYS:  errmsg = strerror(sp->rcerrno);
     break;
   case RCERROR_PARSE: errmsg = "Error parsing logger response";
     break;
@@ -53,32 +117,177 @@ const char *gcstrerror(rcerror_t rcerr) {
     break;
   case RCERROR_MEMALLOC:  errmsg = "Memory allocation error";
     break;
+  case RCERROR_SEQUENCE: errmsg = "Log data sentence missing or out of order";
+    break;
   default:
     errmsg = "Invalid gpscomm error number";
   }
 
 #ifdef DEBUG
-  {
-    static char errstr[512];
-    sprintf(errstr, "%s at line %d in file %s", errmsg, rcerrln, __FILE__);
-    return errstr;
-  }
+  sprintf(sp->errstr, "%s at line %d in file %s", errmsg, sp->rcerrln,
+	  __FILE__);
+  return sp->errstr;
 #else
   return errmsg;
 #endif
 }
 
 
+/* Layouts of log data records. Each record consists of the time of
+   the fix, in the last three of four bytes, followed by little-endian
+   fields: single precision latitude and longitude, then altitude and
+   velocity for record types 1 and 2 onwards, and a 32 bit distance for
+   types 3 and 4. Type 4 records end with satellite status: a byte of
+   unknown purpose, the number of satellites used, 16 bit horizontal,
+   position, and vertical dilution of precision, 12 pairs of satellite
+   number and signal strength bytes, and the single precision course. */
+#define FXREC_SIZE(fxtyp) ((fxtyp) < 4 ? 12 + 4*(fxtyp) : 60)
+
+
+/*****************************************************************************
+ Return the 16 bit little-endian word at p.
+ *****************************************************************************/
+static inline uint16_t rec_half(const char *p) {
+  return (uint16_t)((uint8_t)p[0] | (uint8_t)p[1] << 8);
+}
+
+
+/*****************************************************************************
+ Return the 32 bit little-endian word at p.
+ *****************************************************************************/
+static inline uint32_t rec_word(const char *p) {
+  uint32_t w;
+
+  memcpy(&w, p, sizeof(w));
+#ifdef WORDS_BIGENDIAN
+  w = bswap_32(w);
+#endif
+  return w;
+}
+
+
+/*****************************************************************************
+ Return the little-endian single precision value at p.
+ *****************************************************************************/
+static inline float rec_float(const char *p) {
+  uint32_t w = rec_word(p);
+  float v;
+
+  memcpy(&v, &w, sizeof(v));
+  return v;
+}
+
+
+/*****************************************************************************
+ Pass a warning for each invalid field of fix gfxp, of record type
+ fxtyp, to the warning callback of session sp.
+ *****************************************************************************/
+static void fix_warn(rtk_session_t *sp, const gps_fix_t *gfxp, int fxtyp) {
+  if (sp->gcwrnfp == NULL)
+    return;
+  if (gfxp->hour > 23 || gfxp->min > 59 || gfxp->sec > 59)
+    sp->gcwrnfp(sp, "invalid time value", __LINE__, __FILE__);
+  if (!isfinite(gfxp->lat))
+    sp->gcwrnfp(sp, "latitude with inf/NaN value", __LINE__, __FILE__);
+  if (!isfinite(gfxp->lng))
+    sp->gcwrnfp(sp, "longitude with inf/NaN value", __LINE__, __FILE__);
+  if (fxtyp > 0 && !isfinite(gfxp->alt))
+    sp->gcwrnfp(sp, "altitude with inf/NaN value", __LINE__, __FILE__);
+  if (fxtyp > 1 && !isfinite(gfxp->vel))
+    sp->gcwrnfp(sp, "velocity with inf/NaN value", __LINE__, __FILE__);
+  if (fxtyp > 3 && !isfinite(gfxp->angle))
+    sp->gcwrnfp(sp, "course with inf/NaN value", __LINE__, __FILE__);
+  /* Still need to determine actual range */
+  if (gfxp->lat < -M_PI || gfxp->lat > 2*M_PI)
+    sp->gcwrnfp(sp, "out of range latitude", __LINE__, __FILE__);
+  if (gfxp->lng < -M_PI || gfxp->lng > M_PI)
+    sp->gcwrnfp(sp, "out of range longitude", __LINE__, __FILE__);
+}
+
+
+/*****************************************************************************
+ Decode nrec log data records of record type fxtyp at rec into gfxp.
+ The unkwn field of each fix is set to signal an invalid fix, and
+ warnings are passed to the warning callback of session sp. Since
+ fxtyp is a constant in each caller, the fields not present in the
+ record type, and the checks on them, are eliminated at compile time.
+ *****************************************************************************/
+static inline void fix_decode_records(rtk_session_t *sp, const char *rec,
+				      int nrec, gps_fix_t *gfxp,
+				      const int fxtyp) {
+  int n;
+
+  for (n = 0; n < nrec; n++, rec += FXREC_SIZE(fxtyp), gfxp++) {
+    gfxp->hour = (uint8_t)rec[1];
+    gfxp->min = (uint8_t)rec[2];
+    gfxp->sec = (uint8_t)rec[3];
+    gfxp->lat = rec_float(rec + 4);
+    gfxp->lng = rec_float(rec + 8);
+    gfxp->alt = (fxtyp > 0)?rec_float(rec + 12):0.0f;
+    gfxp->vel = (fxtyp > 1)?rec_float(rec + 16):0.0f;
+    gfxp->dist = (fxtyp > 2)?rec_word(rec + 20):0;
+    if (fxtyp > 3) {
+      gfxp->unk1 = (uint8_t)rec[24];
+      gfxp->nfix = (uint8_t)rec[25];
+      gfxp->hdop = rec_half(rec + 26);
+      gfxp->pdop = rec_half(rec + 28);
+      gfxp->vdop = rec_half(rec + 30);
+      memcpy(gfxp->sat, rec + 32, sizeof(gfxp->sat));
+      gfxp->angle = rec_float(rec + 56);
+    } else {
+      gfxp->unk1 = gfxp->nfix = 0;
+      gfxp->hdop = gfxp->pdop = gfxp->vdop = 0;
+      memset(gfxp->sat, 0, sizeof(gfxp->sat));
+      gfxp->angle = 0.0f;
+    }
+
+    /* The comparisons fail for NaN values, so that a single test
+       covers the valid case */
+    gfxp->unkwn = !(gfxp->hour <= 23 && gfxp->min <= 59 && gfxp->sec <= 59 &&
+		    gfxp->lat >= -M_PI && gfxp->lat <= 2*M_PI &&
+		    gfxp->lng >= -M_PI && gfxp->lng <= M_PI &&
+		    (fxtyp < 1 || isfinite(gfxp->alt)) &&
+		    (fxtyp < 2 || isfinite(gfxp->vel)) &&
+		    (fxtyp < 4 || isfinite(gfxp->angle)));
+    if (gfxp->unkwn)
+      fix_warn(sp, gfxp, fxtyp);
+  }
+}
+
+
+/* Decoder specialised for each record type */
+#define FIX_DECODER(fxtyp)						\
+  static void fix_decode_##fxtyp(rtk_session_t *sp, const char *rec,	\
+				 int nrec, gps_fix_t *gfxp) {		\
+    fix_decode_records(sp, rec, nrec, gfxp, fxtyp);			\
+  }
+
+FIX_DECODER(0)
+FIX_DECODER(1)
+FIX_DECODER(2)
+FIX_DECODER(3)
+FIX_DECODER(4)
+
+/* Size, description, and decoder of each record type */
+static const struct {
+  unsigned short size;
+  const char *desc;
+  fix_decoder_t decode;
+} fxlyt[NFXTYP] = {
+  {FXREC_SIZE(0), "Time,Lat,Lng", fix_decode_0},
+  {FXREC_SIZE(1), "Time,Lat,Lng,Alt", fix_decode_1},
+  {FXREC_SIZE(2), "Time,Lat,Lng,Alt,Vel", fix_decode_2},
+  {FXREC_SIZE(3), "Time,Lat,Lng,Alt,Vel,Dist", fix_decode_3},
+  {FXREC_SIZE(4), "Time,Lat,Lng,Alt,Vel,Dist,Stat", fix_decode_4}
+};
+
+
 /*****************************************************************************
  Return the number of bytes in the location record for the specified fix type.
  *****************************************************************************/
 unsigned short fix_size(unsigned short fxtyp) {
-  static uint8_t fxsz[3] = {sizeof(gps_fix_t)-2*sizeof(float),
-			  sizeof(gps_fix_t)-sizeof(float),
-			  sizeof(gps_fix_t)};
-
-  if (fxtyp < 3)
-    return fxsz[fxtyp];
+  if (fxtyp < NFXTYP)
+    return fxlyt[fxtyp].size;
   else
     return 0;
 }
@@ -88,15 +297,22 @@ unsigned short fix_size(unsigned short fxtyp) {
  Return a string description corresponding to the fix type argument.
  *****************************************************************************/
 const char *fxtyp_string(unsigned short fxtyp) {
-  switch (fxtyp) {
-  case 0: return "Time,Lat,Lng";
-    break;
-  case 1: return "Time,Lat,Lng,Alt";
-    break;
-  case 2: return "Time,Lat,Lng,Alt,Vel";
-    break;
-  default: return "Invalid";
-  }
+  if (fxtyp < NFXTYP)
+    return fxlyt[fxtyp].desc;
+  else
+    return "Invalid";
+}
+
+
+/*****************************************************************************
+ Return the decoder for records of the specified fix type, or NULL if
+ the fix type is not valid.
+ *****************************************************************************/
+fix_decoder_t fix_decoder(unsigned short fxtyp) {
+  if (fxtyp < NFXTYP)
+    return fxlyt[fxtyp].decode;
+  else
+    return NULL;
 }
 
 
@@ -205,15 +421,22 @@ uint8_t string_checksum(const char *str) {
  Verify the checksum of the bsz length (including checksum) content of buf.
  *****************************************************************************/
 int verify_array_checksum(const char *buf, int bsz) {
+  static const char *hexd = "0123456789ABCDEF";
+  const char *hp, *lp;
   unsigned int csc, cse;
 
-  if (sscanf(buf+bsz-2, "%02X", &cse) < 1) {
+  /* Explicit checksum is scanned without sscanf since buf need not be
+     a terminated string */
+  if (bsz < 4 || buf[bsz-2] == '\0' || buf[bsz-1] == '\0' ||
+      (hp = strchr(hexd, toupper(buf[bsz-2]))) == NULL ||
+      (lp = strchr(hexd, toupper(buf[bsz-1]))) == NULL) {
 #ifdef DEBUG
     fprintf(stderr, "\n=== Checksum Error  Could not scan explicit checksum"
 	    " in string %.2s\n", buf+bsz-2);
-    return 0;
 #endif
+    return 0;
   }
+  cse = 16*(hp - hexd) + (lp - hexd);
   csc = array_checksum(buf+1, bsz-4);
 
 #ifdef DEBUG
@@ -238,23 +461,82 @@ int verify_string_checksum(const char *str) {
 
 
 /*****************************************************************************
- Write command str to file descriptor fd.
+ Update response time estimate rtp with measured response time r. The
+ smoothed estimate and its variation are computed as for the TCP
+ retransmission timer (RFC 6298).
+ *****************************************************************************/
+static void rtt_update(rtt_est_t *rtp, long int r) {
+  long int d;
+
+  if (rtp->srtt == 0) {
+    rtp->srtt = (r > 0)?r:1;
+    rtp->rttvar = r/2;
+  } else {
+    d = (rtp->srtt > r)?rtp->srtt - r:r - rtp->srtt;
+    rtp->rttvar += (d - rtp->rttvar)/4;
+    rtp->srtt += (r - rtp->srtt)/8;
+    if (rtp->srtt <= 0)
+      rtp->srtt = 1;
+  }
+}
+
+
+/*****************************************************************************
+ Update response time estimate rtp with the time elapsed since t0, at
+ which a command was sent or the previous sentence of a response was
+ received.
+ *****************************************************************************/
+void rtt_sample(rtt_est_t *rtp, const struct timespec *t0) {
+  rtt_update(rtp, deadline_elapsed(t0));
+}
+
+
+/*****************************************************************************
+ Return the time, in ms, within which a response with time estimate
+ rtp is expected, without the lower bound applied to timeouts. Until
+ a response time has been measured, default tmt is returned.
+ *****************************************************************************/
+long int rtt_margin(const rtt_est_t *rtp, long int tmt) {
+  if (rtp->srtt == 0)
+    return tmt;
+
+  tmt = (rtp->srtt + 4*rtp->rttvar + 999)/1000;
+  return (tmt > RTT_MXTMT)?RTT_MXTMT:tmt;
+}
+
+
+/*****************************************************************************
+ Return the timeout, in ms, for a response with time estimate rtp.
+ Until a response time has been measured, default timeout tmt is
+ returned.
  *****************************************************************************/
-int send_cmd(int fd, const char* str) {
+long int rtt_timeout(const rtt_est_t *rtp, long int tmt) {
+  if (rtp->srtt == 0)
+    return tmt;
+
+  tmt = rtt_margin(rtp, tmt);
+  return (tmt < RTT_MNTMT)?RTT_MNTMT:tmt;
+}
+
+
+/*****************************************************************************
+ Write command str to session sp.
+ *****************************************************************************/
+int send_cmd(rtk_session_t *sp, const char* str) {
   char *buf;
   int sln, chk, wn;
 
   sln = strlen(str);
   chk = array_checksum(str, sln);
   if (chk < 0 || chk > 255) {
-    rcerrno = RCERROR_CHECKSUM;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_CHECKSUM;
+    sp->rcerrln = __LINE__;
     return -1;
   }
   buf = malloc(sln + 5);
   if (buf == NULL) {
-    rcerrno = RCERROR_MEMALLOC;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_MEMALLOC;
+    sp->rcerrln = __LINE__;
     return -1;
   }
   sprintf(buf, "%s%02X\r\n", str, chk);
@@ -263,10 +545,10 @@ int send_cmd(int fd, const char* str) {
   fprintf(stderr, ">>> %s",buf);
 #endif
 
-  wn = serial_write(fd, buf, sln+4);
+  wn = serial_write(sp->tp, buf, sln+4);
   if (wn < 0) {
-    rcerrno = RCERROR_SYS;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
     free(buf);
     return -1;
   }
@@ -277,40 +559,70 @@ int send_cmd(int fd, const char* str) {
 
 
 /*****************************************************************************
- Write command cmnd to file descriptor fd and read response.
+ Read the sentence starting with prefix pfx from session sp into
+ buffer rsp of size rsz.
  *****************************************************************************/
-char *get_cmd_response(int fd, const char *cmd, const char *pfx,
-		       char *rsp, int rsz) {
-  short int wn, rn;
-
-  wn = send_cmd(fd, cmd);
-  if (wn < 0)
-    return NULL;
-  rn = serial_read_string(fd, rsp, rsz, 0, pfx, "\r\n", 2000);
-
+char *get_response(rtk_session_t *sp, const char *pfx, char *rsp, int rsz,
+		   long int tmt) {
+  struct timespec dl;
+  ssize_t rn;
+
+  /* The timeout applies to the complete response, irrespective of
+     how many reads are required to receive it */
+  deadline_set(&dl, tmt);
+  rn = serial_read_string(sp->tp, pfx, "\r\n", rsz-1, &dl);
   if (rn < 0) {
-    rcerrno = RCERROR_SYS;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
     return NULL;
   }
-  if (rn == 0 && rsp[0] == '\0') {
-    rcerrno = RCERROR_NORSP;
-    rcerrln = __LINE__;
+  if (rn == 0) {
+    /* Distinguish between no response, including input that has not
+       formed a complete sentence by the deadline, and input that can
+       not be parsed as a sentence */
+    sp->rcerrno = (serial_buffered(sp->tp) == 0 ||
+		   deadline_remaining(&dl) == 0)?RCERROR_NORSP:RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
     return NULL;
   }
-  if (rn == 0 && rsp[0] != '\0') {
-    rcerrno = RCERROR_PARSE;
-    rcerrln = __LINE__;
+
+  memcpy(rsp, serial_peek(sp->tp), rn);
+  rsp[rn] = '\0';
+  serial_consume(sp->tp, rn);
+
+  return rsp;
+}
+
+
+/*****************************************************************************
+ Write command cmnd to session sp and read response, waiting at least
+ mntmt ms for it.
+ *****************************************************************************/
+static char *cmd_response(rtk_session_t *sp, const char *cmd, const char *pfx,
+			  char *rsp, int rsz, long int mntmt) {
+  struct timespec t0;
+  long int tmt;
+  short int wn;
+
+  deadline_set(&t0, 0);
+  wn = send_cmd(sp, cmd);
+  if (wn < 0)
     return NULL;
-  }
+  tmt = rtt_timeout(&sp->cmdrt, 2000);
+  if (get_response(sp, pfx, rsp, rsz, (tmt > mntmt)?tmt:mntmt) == NULL)
+    return NULL;
+  /* The response time of a command that writes to memory is not that
+     of other commands, and would inflate the estimate */
+  if (mntmt == 0)
+    rtt_sample(&sp->cmdrt, &t0);
 
 #ifdef DEBUG
   fprintf(stderr, "<<< %s", rsp);
 #endif
 
   if (!verify_string_checksum(rsp)) {
-    rcerrno = RCERROR_CHECKSUM;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_CHECKSUM;
+    sp->rcerrln = __LINE__;
     return NULL;
   }
 
@@ -319,77 +631,70 @@ char *get_cmd_response(int fd, const char *cmd, const char *pfx,
 
 
 /*****************************************************************************
- Read a single NMEA sentence from file descriptor fd.
+ Write command cmnd to session sp and read response.
+ *****************************************************************************/
+char *get_cmd_response(rtk_session_t *sp, const char *cmd, const char *pfx,
+		       char *rsp, int rsz) {
+  return cmd_response(sp, cmd, pfx, rsp, rsz, 0);
+}
+
+
+/*****************************************************************************
+ Read a single NMEA sentence from session sp.
  *****************************************************************************/
-char *get_sentence(int fd, long int tmt) {
-  static char buf[256] = {0};
-  static char snt[256] = {0};
-  static short int n = 0;
+char *get_sentence(rtk_session_t *sp, long int tmt) {
+  return get_response(sp, "$", sp->snt, sizeof(sp->snt), tmt);
+}
 
-  n = serial_read_string(fd, buf, 256, n, "$", "\r\n", tmt);
-  if (n > 0) {
-    short int m;
 
-    m = strstr(buf, "\r\n") + 2 - buf;
-    memcpy(snt, buf, m);
-    snt[m] = '\0';
-    n -= m;
-    memmove(buf, buf+m, n);
-    buf[n] = '\0';
-    return snt;
-  } else
-    return NULL;
+/*****************************************************************************
+ Read the next complete sentence of any type from session sp into
+ buffer rsp of size rsz, before deadline dlp. Input that can not be
+ parsed as a sentence, such as the binary content of log data, is
+ skipped.
+ *****************************************************************************/
+static char *get_any_sentence(rtk_session_t *sp, char *rsp, int rsz,
+			      const struct timespec *dlp) {
+  while (get_response(sp, "$", rsp, rsz, deadline_remaining(dlp)) == NULL) {
+    if (sp->rcerrno != RCERROR_PARSE || deadline_remaining(dlp) == 0)
+      return NULL;
+    serial_consume(sp->tp, 1);
+  }
+
+  return rsp;
 }
 
 
 /*****************************************************************************
- Get status parameters via file descriptor fd.
+ Get status parameters via session sp.
  *****************************************************************************/
-int get_status(int fd, status_t *status) {
-  short int rn, wn, sn;
+int get_status(rtk_session_t *sp, status_t *status) {
+  struct timespec t0, dl, mdl;
+  short int wn, sn, nlg = 0;
+  long int r = 0;
   char buf[256] = "";
 
-  rn = serial_read_string(fd, buf, 256, 0, "$LOG108", "\r\n", 1500);
-  if (rn < 0) {
-    rcerrno = RCERROR_SYS;
-    rcerrln = __LINE__;
-    return -1;
-  }
-  if (rn == 0 && buf[0] != '\0') {
-    rcerrno = RCERROR_PARSE;
-    rcerrln = __LINE__;
+  /* Request LOG108 data immediately, rather than first waiting to see
+     whether it is output in GPS mouse mode */
+  deadline_set(&t0, 0);
+  wn = send_cmd(sp, "$PROY108*");
+  if (wn < 0) {
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
     return -1;
   }
-
-#ifdef DEBUG
-  if (rn > 0)
-    fprintf(stderr, "<<< %.256s", buf);
-#endif
-
-  if (rn == 0) {
-    /* Nothing received -- assume GPS mouse mode is disabled */
-    status->gpsms = 0;
-    /* In this mode, need to explicitly request LOG108 data */
-    wn = send_cmd(fd, "$PROY108*");
-    if (wn < 0) {
-      rcerrno = RCERROR_SYS;
-      rcerrln = __LINE__;
-      return -1;
-    }
-    rn = serial_read_string(fd, buf, 256, 0, "$LOG108", "\r\n", 1500);
-    if (rn < 0) {
-      rcerrno = RCERROR_SYS;
-      rcerrln = __LINE__;
-      return -1;
-    }
-    if (rn == 0 && buf[0] == '\0') {
-      rcerrno = RCERROR_NORSP;
-      rcerrln = __LINE__;
-      return -1;
-    }
-    if (rn == 0 && buf[0] != '\0') {
-      rcerrno = RCERROR_PARSE;
-      rcerrln = __LINE__;
+  deadline_set(&dl, rtt_timeout(&sp->cmdrt, 1500));
+  /* In GPS mouse mode, NMEA sentences and LOG108 data are output
+     every second, so that mouse mode is enabled if either is received
+     within this period, in addition to the requested LOG108 data */
+  deadline_set(&mdl, 1000 + rtt_margin(&sp->cmdrt, 100));
+  status->gpsms = 0;
+
+  while (nlg == 0 || (!status->gpsms && deadline_remaining(&mdl) > 0)) {
+    if (get_any_sentence(sp, buf, 256, (nlg == 0)?&dl:&mdl) == NULL) {
+      /* Nothing further received -- GPS mouse mode is disabled */
+      if (nlg > 0 && sp->rcerrno != RCERROR_SYS)
+	break;
       return -1;
     }
 
@@ -397,83 +702,107 @@ int get_status(int fd, status_t *status) {
     fprintf(stderr, "<<< %.256s", buf);
 #endif
 
-  } else {
-    /* Text received -- GPS mouse mode is be enabled */
-    status->gpsms = 1;
-  }
+    if (strncmp(buf, "$LOG108", 7) == 0) {
+      if (nlg++ > 0) {
+	status->gpsms = 1;
+	continue;
+      }
+      r = deadline_elapsed(&t0);
 
-  if (!verify_string_checksum(buf)) {
-    rcerrno = RCERROR_CHECKSUM;
-    rcerrln = __LINE__;
-    return -1;
-  }
+      if (!verify_string_checksum(buf)) {
+	sp->rcerrno = RCERROR_CHECKSUM;
+	sp->rcerrln = __LINE__;
+	return -1;
+      }
 
-  sn = sscanf(buf, "$LOG108,%hd,%hd,%hd,%hd,%hd,%hd,%hd,%hd,%d*",
-	      &status->fxtyp, &status->unkwn0, &status->unkwn1,
-	      &status->mfowm, &status->unkwn2, &status->sntvl,
-	      &status->gpsrx, &status->nfile, &status->nfix);
-  if (sn != 9) {
-    rcerrno = RCERROR_PARSE;
-    rcerrln = __LINE__;
-    return -1;
+      sn = sscanf(buf, "$LOG108,%hd,%hd,%hd,%hd,%hd,%hd,%hd,%hd,%d*",
+		  &status->fxtyp, &status->unkwn0, &status->unkwn1,
+		  &status->mfowm, &status->unkwn2, &status->sntvl,
+		  &status->gpsrx, &status->nfile, &status->nfix);
+      if (sn != 9) {
+	sp->rcerrno = RCERROR_PARSE;
+	sp->rcerrln = __LINE__;
+	return -1;
+      }
+    } else if (strncmp(buf, "$GP", 3) == 0)
+      status->gpsms = 1;
   }
 
+  /* In GPS mouse mode, the LOG108 data taken as the response may have
+     been output before the request was received, so that the response
+     time is only measured when mouse mode is disabled */
+  if (!status->gpsms)
+    rtt_update(&sp->cmdrt, r);
+
   return 1;
 }
 
 
 /*****************************************************************************
- Get current UTC date/time via file descriptor fd.
+ Get current UTC date/time via session sp.
  *****************************************************************************/
-int get_current_utc(int fd, date_time_t *dtp) {
+int get_current_utc(rtk_session_t *sp, date_time_t *dtp) {
+  struct timespec t0, dl;
   char buf[256] = "";
   char date[8] = "";
   char *lp = NULL;
-  short int rn, sn, n;
+  short int wn, sn, n;
 
-  rn = serial_read_string(fd, buf, 256, 0, "$GPRMC", "\r\n", 1100);
-  if (rn < 0) {
-    rcerrno = RCERROR_SYS;
-    rcerrln = __LINE__;
-    return -1;
-  }
-  if (rn == 0 && buf[0] != '\0') {
-    rcerrno = RCERROR_PARSE;
-    rcerrln = __LINE__;
+  /* Request the date/time immediately, and use either the response
+     or a GPRMC sentence output in GPS mouse mode, whichever is
+     received first */
+  deadline_set(&t0, 0);
+  wn = send_cmd(sp, "$PROY003*");
+  if (wn < 0) {
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
     return -1;
   }
-  if (rn > 0) {
+  deadline_set(&dl, rtt_timeout(&sp->cmdrt, 2000));
+  do {
+    if (get_any_sentence(sp, buf, 256, &dl) == NULL)
+      return -1;
+  } while (strncmp(buf, "$GPRMC", 6) != 0 && strncmp(buf, "$LOG003", 7) != 0);
+
+#ifdef DEBUG
+  fprintf(stderr, "<<< %.256s", buf);
+#endif
+
+  if (buf[1] == 'G') {
     sn = sscanf(buf, "$GPRMC,%6s,", dtp->time);
     if (sn != 1) {
-      rcerrno = RCERROR_PARSE;
-      rcerrln = __LINE__;
+      sp->rcerrno = RCERROR_PARSE;
+      sp->rcerrln = __LINE__;
       return -1;
     }
     lp = buf;
     for (n = 0; n < 9; n++) {
       lp = strchr(lp, ',');
       if (lp == NULL) {
-	rcerrno = RCERROR_PARSE;
-	rcerrln = __LINE__;
+	sp->rcerrno = RCERROR_PARSE;
+	sp->rcerrln = __LINE__;
 	return -1;
       }
       lp++;
     }
     sn = sscanf(lp, "%6s,", date);
     if (sn != 1) {
-      rcerrno = RCERROR_PARSE;
-      rcerrln = __LINE__;
+      sp->rcerrno = RCERROR_PARSE;
+      sp->rcerrln = __LINE__;
       return -1;
     }
     sprintf(dtp->date, "20%.2s%.2s%.2s", date+4, date+2, date);
   } else {
-    lp = get_cmd_response(fd, "$PROY003*", "$LOG003", buf, 64);
-    if (lp == NULL)
+    rtt_sample(&sp->cmdrt, &t0);
+    if (!verify_string_checksum(buf)) {
+      sp->rcerrno = RCERROR_CHECKSUM;
+      sp->rcerrln = __LINE__;
       return -1;
-    sn = sscanf(lp, "$LOG003,%8s,%6s*", dtp->date, dtp->time);
+    }
+    sn = sscanf(buf, "$LOG003,%8s,%6s*", dtp->date, dtp->time);
     if (sn != 2) {
-      rcerrno = RCERROR_PARSE;
-      rcerrln = __LINE__;
+      sp->rcerrno = RCERROR_PARSE;
+      sp->rcerrln = __LINE__;
       return -1;
       }
   }
@@ -483,22 +812,22 @@ int get_current_utc(int fd, date_time_t *dtp) {
 
 
 /*****************************************************************************
- Get log start and end date/time via file descriptor fd.
+ Get log start and end date/time via session sp.
  *****************************************************************************/
-int get_log_bndry(int fd, log_bndry_t *lgbp) {
+int get_log_bndry(rtk_session_t *sp, log_bndry_t *lgbp) {
   char rsp[64] = "";
   char *lp = NULL;
   short int sn;
 
-  lp = get_cmd_response(fd, "$PROY006*", "$LOG006", rsp, 64);
+  lp = get_cmd_response(sp, "$PROY006*", "$LOG006", rsp, 64);
   if (lp == NULL)
     return -1;
 
   sn = sscanf(lp, "$LOG006,%8s,%6s,%8s,%6s*", lgbp->first.date,
 	      lgbp->first.time, lgbp->last.date, lgbp->last.time);
   if (sn != 4) {
-    rcerrno = RCERROR_PARSE;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
     return -1;
   }
 
@@ -507,22 +836,22 @@ int get_log_bndry(int fd, log_bndry_t *lgbp) {
 
 
 /*****************************************************************************
- Get logger memory information via file descriptor fd.
+ Get logger memory information via session sp.
  *****************************************************************************/
-int get_memory_info(int fd, memory_t *memp) {
+int get_memory_info(rtk_session_t *sp, memory_t *memp) {
   char rsp[64] = "";
   char *lp = NULL;
   short int sn;
 
-  lp = get_cmd_response(fd, "$PROY100*", "$LOG100", rsp, 64);
+  lp = get_cmd_response(sp, "$PROY100*", "$LOG100", rsp, 64);
   if (lp == NULL)
     return -1;
 
   sn = sscanf(lp, "$LOG100,%lu,%u,%u*", &memp->nbytes, &memp->sctrsz,
 	      &memp->nmsctr);
   if (sn != 3) {
-    rcerrno = RCERROR_PARSE;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
     return -1;
   }
 
@@ -531,74 +860,152 @@ int get_memory_info(int fd, memory_t *memp) {
 
 
 /*****************************************************************************
- Get logger firmware information via file descriptor fd.
+ Read a multi-sentence response from session sp, passing each
+ sentence starting with prefix pfx to handler hndl, with argument arg.
+ Reading ends when the handler returns zero to indicate that all
+ expected sentences have been received, when no sentence is received
+ within tmt ms of the start of the response, or when no further
+ sentence is received within an idle gap of tmi ms after the previous
+ one. Returns the number of sentences received, or -1 on error.
  *****************************************************************************/
-int get_firmware_info(int fd, firmware_t *frmp) {
-  firmware_t frm0 = {"","","",""};
-  char rsp[512] = "";
-  char *lp, *cp, *sp;
-  short int wn, rn, ln, sn = 0;
+int get_sentences(rtk_session_t *sp, const char *pfx,
+		  int (*hndl)(char *, void *), void *arg,
+		  long int tmt, long int tmi) {
+  struct timespec t0, dl;
+  char snt[256];
+  ssize_t rn;
+  int sn = 0;
+
+  deadline_set(&t0, 0);
+  deadline_set(&dl, tmt);
+  while ((rn = serial_read_string(sp->tp, pfx, "\r\n", sizeof(snt)-1,
+				 &dl)) > 0) {
+    memcpy(snt, serial_peek(sp->tp), rn);
+    snt[rn] = '\0';
+    serial_consume(sp->tp, rn);
 
-  wn = send_cmd(fd, "$PROY005*");
-  if (wn < 0) {
-    rcerrno = RCERROR_SYS;
-    rcerrln = __LINE__;
-    return -1;
+#ifdef DEBUG
+    fprintf(stderr, "<<< %s", snt);
+#endif
+
+    if (sn++ == 0)
+      rtt_sample(&sp->cmdrt, &t0);
+    if (!hndl(snt, arg))
+      return sn;
+    deadline_set(&dl, tmi);
   }
-  rn = serial_read_repeat(fd, rsp, 511, 1000);
   if (rn < 0) {
-    rcerrno = RCERROR_SYS;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
     return -1;
   }
-  if (rn == 0) {
-    rcerrno = RCERROR_NORSP;
-    rcerrln = __LINE__;
+  if (sn == 0) {
+    sp->rcerrno = (serial_buffered(sp->tp) == 0 ||
+		   deadline_remaining(&dl) == 0)?RCERROR_NORSP:RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
     return -1;
   }
-  rsp[rn] = '\0';
 
-#ifdef DEBUG
-  fprintf(stderr, "<<< %.512s\n", rsp);
-#endif
+  return sn;
+}
 
-  *frmp = frm0;
-  lp = rsp;
-  while (lp < rsp + 512 && sn < 5) {
-    lp = find_sentence(lp, 512, "PSRFTXT");
-    if (lp == NULL) {
-      rcerrno = RCERROR_PARSE;
-      rcerrln = __LINE__;
-      return -1;
+
+/*****************************************************************************
+ Parse a single PSRFTXT sentence of the firmware information response
+ into the firmware_t structure pointed to by arg. Returns zero once all
+ fields have been set.
+ *****************************************************************************/
+static int firmware_sentence(char *lp, void *arg) {
+  firmware_t *frmp = arg;
+  char *cp, *sp;
+
+  if ((cp = strstr(lp, "VersionR: ")) != NULL) {
+    cp = cp + strlen("VersionR: ");
+    sscanf(cp, "%[^*]*", frmp->vrsnr);
+  } else if ((cp = strstr(lp, "] ")) != NULL) {
+    if ((sp = strchr(cp, '*')) != NULL) {
+      *sp = '\0';
+      cp = cp + strlen("] ");
+      strncpy(frmp->frmwr, cp, 63);
+      *(frmp->frmwr + 63) = '\0';
     }
-    ln = strlen(lp);
-    if ((cp = strstr(lp, "VersionR: ")) != NULL) {
-      cp = cp + strlen("VersionR: ");
-      sscanf(cp, "%[^*]*", frmp->vrsnr);
-    } else if ((cp = strstr(lp, "] ")) != NULL) {
-      if ((sp = strchr(cp, '*')) != NULL) {
-	*sp = '\0';
-	cp = cp + strlen("] ");
-	strncpy(frmp->frmwr, cp, 63);
-	*(frmp->frmwr + 64) = '\0';
-      }
-    } else if ((cp = strstr(lp, "[ONOFFLOG]")) != NULL) {
-      /* RGM 3800 response "[ONOFFLOG]RoyalTek Ver 1.4.0.211 GSW3LP*58\r\n" */
-      if ((sp = strchr(cp, '*')) != NULL) {
-	*sp = '\0';
-	cp += sizeof("[ONOFFLOG]")-1;
-	strncpy(frmp->frmwr, cp, 63);
-	*(frmp->frmwr + 64) = '\0';
-      }
-    } else if ((cp = strstr(lp, "Baud rate: ")) != NULL) {
-      cp = cp + strlen("Baud rate: ");
-      sscanf(cp, "%[^*]*", frmp->dflbd);
-    } else if ((cp = strstr(lp, "Driver Revision = ")) != NULL) {
-      cp = cp + strlen("Driver Revision = ");
-      sscanf(cp, "%[^*]*", frmp->drvrv);
+  } else if ((cp = strstr(lp, "[ONOFFLOG]")) != NULL) {
+    /* RGM 3800 response "[ONOFFLOG]RoyalTek Ver 1.4.0.211 GSW3LP*58\r\n" */
+    if ((sp = strchr(cp, '*')) != NULL) {
+      *sp = '\0';
+      cp += sizeof("[ONOFFLOG]")-1;
+      strncpy(frmp->frmwr, cp, 63);
+      *(frmp->frmwr + 63) = '\0';
     }
-    sn++;
-    lp = lp + ln + 1;
+  } else if ((cp = strstr(lp, "Baud rate: ")) != NULL) {
+    cp = cp + strlen("Baud rate: ");
+    sscanf(cp, "%[^*]*", frmp->dflbd);
+  } else if ((cp = strstr(lp, "Driver Revision = ")) != NULL) {
+    cp = cp + strlen("Driver Revision = ");
+    sscanf(cp, "%[^*]*", frmp->drvrv);
+  }
+
+  return (frmp->vrsnr[0] == '\0' || frmp->frmwr[0] == '\0' ||
+	  frmp->dflbd[0] == '\0' || frmp->drvrv[0] == '\0');
+}
+
+
+/*****************************************************************************
+ Get logger firmware information via session sp.
+ *****************************************************************************/
+int get_firmware_info(rtk_session_t *sp, firmware_t *frmp) {
+  firmware_t frm0 = {"","","",""};
+  short int wn;
+
+  wn = send_cmd(sp, "$PROY005*");
+  if (wn < 0) {
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+
+  /* The response consists of up to five PSRFTXT sentences, which are
+     parsed as they arrive, so that reading can end as soon as all of
+     the required fields have been received */
+  *frmp = frm0;
+  if (get_sentences(sp, "$PSRFTXT", firmware_sentence, frmp,
+		    rtt_timeout(&sp->cmdrt, 1000), RSP_IDLE) < 0)
+    return -1;
+
+  return 1;
+}
+
+
+/*****************************************************************************
+ Discard input from session sp until none is received for an idle gap, so that
+ responses to outstanding requests are not mistaken for responses to
+ subsequent commands.
+ *****************************************************************************/
+static void data_discard(rtk_session_t *sp) {
+  struct timespec dl;
+
+  do {
+    serial_consume(sp->tp, serial_buffered(sp->tp));
+    deadline_set(&dl, RSP_IDLE);
+  } while (serial_fill(sp->tp, &dl) > 0);
+  serial_consume(sp->tp, serial_buffered(sp->tp));
+}
+
+
+/*****************************************************************************
+ Parse file metadata response lp into lgfp, recording any error in
+ session sp.
+ *****************************************************************************/
+static int parse_file_info(rtk_session_t *sp, const char *lp,
+			   logfile_t *lgfp) {
+  short int sn;
+
+  sn = sscanf(lp, "$LOG101,%8[^,],%hd,%d,%d*", lgfp->date, &lgfp->fxtyp,
+	      &lgfp->nfix, &lgfp->memp);
+  if (sn != 4) {
+    sp->rcerrno = RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
+    return -1;
   }
 
   return 1;
@@ -606,48 +1013,108 @@ int get_firmware_info(int fd, firmware_t *frmp) {
 
 
 /*****************************************************************************
- Read file metadata for file number filen into lgfp via file descriptor fd.
+ Read file metadata for file number filen into lgfp via session sp.
  *****************************************************************************/
-int get_file_info(int fd, short int filen, logfile_t *lgfp) {
+int get_file_info(rtk_session_t *sp, short int filen, logfile_t *lgfp) {
   char cmd[32];
   char rsp[64] = "";
   char *lp = NULL;
-  short int sn;
 
   sprintf(cmd, "$PROY101,%hd*", filen);
-  lp = get_cmd_response(fd, cmd, "$LOG101", rsp, 64);
+  lp = get_cmd_response(sp, cmd, "$LOG101", rsp, 64);
   if (lp == NULL)
     return -1;
 
-  sn = sscanf(lp, "$LOG101,%[^,],%hd,%d,%d*", lgfp->date, &lgfp->fxtyp,
-	      &lgfp->nfix, &lgfp->memp);
-  if (sn != 4) {
-    rcerrno = RCERROR_PARSE;
-    rcerrln = __LINE__;
-    return -1;
+  return parse_file_info(sp, lp, lgfp);
+}
+
+
+/*****************************************************************************
+ Read file metadata for the nfile files starting at file number fn0
+ via session sp, keeping up to nwin requests outstanding, so that
+ the logger does not wait for each request after responding to the
+ previous one. The metadata for each file is passed to handler hndl,
+ with the file number and argument arg, as soon as it is received.
+ Responses do not include the file number, and are matched to
+ requests by their order. Returns the number of files, or -1 on
+ error.
+ *****************************************************************************/
+int get_files_info(rtk_session_t *sp, short int fn0, short int nfile,
+		   int nwin, void (*hndl)(short int, const logfile_t *, void *),
+		   void *arg) {
+  struct timespec t0;
+  char cmd[32];
+  char rsp[64];
+  logfile_t lgfl;
+  short int srn = fn0, rrn = fn0;
+  int pn;
+
+  deadline_set(&t0, 0);
+  while (rrn < fn0 + nfile) {
+    /* Send requests until the window is full */
+    while (srn - rrn < nwin && srn < fn0 + nfile) {
+      sprintf(cmd, "$PROY101,%hd*", srn);
+      if (send_cmd(sp, cmd) < 0) {
+	if (srn > rrn)
+	  data_discard(sp);
+	return -1;
+      }
+      srn++;
+    }
+
+    /* The first response is timed from its request, and each
+       subsequent response from the previous one, since the logger
+       responds to queued requests without waiting */
+    if (get_response(sp, "$LOG101", rsp, sizeof(rsp),
+		     rtt_timeout(&sp->cmdrt, 2000)) == NULL) {
+      if (srn > rrn + 1)
+	data_discard(sp);
+      return -1;
+    }
+    if (rrn == fn0)
+      rtt_sample(&sp->cmdrt, &t0);
+
+#ifdef DEBUG
+    fprintf(stderr, "<<< %s", rsp);
+#endif
+
+    if (!verify_string_checksum(rsp)) {
+      sp->rcerrno = RCERROR_CHECKSUM;
+      sp->rcerrln = __LINE__;
+      pn = -1;
+    } else
+      pn = parse_file_info(sp, rsp, &lgfl);
+    if (pn < 0) {
+      if (srn > rrn + 1)
+	data_discard(sp);
+      return -1;
+    }
+    hndl(rrn, &lgfl, arg);
+    rrn++;
   }
 
-  return 1;
+  return nfile;
 }
 
 
 /*****************************************************************************
  Get date and time of first fix in file described by lgfp.
  *****************************************************************************/
-int get_file_start_time(int fd, const logfile_t *lgfp, date_time_t *dtp) {
-  void (*tmpfp)(unsigned short, unsigned short);
+int get_file_start_time(rtk_session_t *sp, const logfile_t *lgfp,
+			date_time_t *dtp) {
+  void (*tmpfp)(rtk_session_t *, int, int);
   gps_fix_t fx0;
   int rrn;
 
-  tmpfp = gdpfp;
-  gdpfp = 0;
-  rrn = get_data(fd, lgfp->memp, lgfp->fxtyp, 1, &fx0, lgfp->nfix, 0);
-  gdpfp = tmpfp;
+  tmpfp = sp->gdpfp;
+  sp->gdpfp = 0;
+  rrn = get_data(sp, lgfp->memp, lgfp->fxtyp, 1, &fx0, lgfp->nfix, 0);
+  sp->gdpfp = tmpfp;
   if (rrn < 0)
     return -1;
   if (rrn != 1) {
-    rcerrno = RCERROR_PARSE;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
     return -1;
   }
 
@@ -659,277 +1126,769 @@ int get_file_start_time(int fd, const logfile_t *lgfp, date_time_t *dtp) {
 
 
 /*****************************************************************************
- Get nfix fixes of logfile data starting at logger memory address
- memp, for record type fxtyp.
+ Decode nrec log data records at rec, of record type fxtyp, into gfxp.
+ The unkwn field of each fix is set to signal an invalid fix, and a
+ warning is passed to the warning callback of session sp.
  *****************************************************************************/
-int get_data(int fd, int memp, short int fxtyp, int nfix,
-	     gps_fix_t *gfxp, int nfxt, int nfxb) {
-  const long int tmt = 1000;
-  char cmd[32];
-  char buf[512] = "";
-  uint8_t rbc, rsi = 0;
-  int sln;
-  int bn = 0, sn = 0, fn = 0;
-  int wn, rn;
+void fix_decode(rtk_session_t *sp, const char *rec, short int fxtyp,
+		int nrec, gps_fix_t *gfxp) {
+  fix_decoder_t dcdp;
 
-  /* Set up data retrieve command */
-  sprintf(cmd, "$PROY102,%d,%hd,%hd*", memp, fxtyp, nfix);
-  /* Send command */
-  wn = send_cmd(fd, cmd);
-  if (wn < 0) {
-    rcerrno = RCERROR_SYS;
-    rcerrln = __LINE__;
+  if ((dcdp = fix_decoder(fxtyp)) != NULL)
+    dcdp(sp, rec, nrec, gfxp);
+}
+
+
+/*****************************************************************************
+ Read a complete $LOG102 sentence from session sp before deadline dlp, leaving
+ it at the start of the input buffer, given that at least nrb further
+ bytes of fixes are expected. Returns the sentence length, which is 11
+ for the response to an invalid request, or -1 on error.
+ *****************************************************************************/
+static int read_data_sentence(rtk_session_t *sp, int nrb,
+			      const struct timespec *dlp) {
+  const char *buf;
+  int rn, sln;
+
+  /* Try to get initial $LOG102 prefix and check result for errors. */
+  rn = serial_read_discard(sp->tp, "$LOG102", dlp);
+  if (rn < 0) {
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+  if (rn == 0) {
+    sp->rcerrno = (serial_buffered(sp->tp) == 0 ||
+		   deadline_remaining(dlp) == 0)?RCERROR_NORSP:RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
     return -1;
   }
 
+  /* If buffer doesn't include sentence length byte, try to read the
+     necessary additional bytes, and check result for errors. */
+  rn = serial_read_count(sp->tp, 11, dlp);
+  if (rn < 0) {
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+  if (rn == 0) {
+    sp->rcerrno = RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+  buf = serial_peek(sp->tp);
+
+  /* The response to an invalid request has no sentence length byte */
+  if (memcmp(buf, "$LOG102,0*6B", 11) == 0)
+    return 11;
+
+  /* Compute sentence length (up to end of "\r\n") from byte count
+     for remainder of sentence */
+  sln = 11 + (uint8_t)buf[10] + 5;
+
+  /* At least the remaining fixes and the overhead of the current
+     sentence are still to be received, which allows them to be read
+     in large blocks rather than as they trickle in */
+  nrb += 16 - (int)serial_buffered(sp->tp);
+  serial_expect(sp->tp, (nrb > 0)?nrb:0);
+
+  /* If number of bytes buffered is less than sentence length, try
+     to read remainder of sentence, and check result for errors. */
+  rn = serial_read_count(sp->tp, sln, dlp);
+  if (rn < 0) {
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+  if (rn == 0) {
+    sp->rcerrno = RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+
+#ifdef DEBUG
+  /* Buffer location may have changed during read */
+  buf = serial_peek(sp->tp);
+  fprintf(stderr, "<<< %8.8s", buf);
+  {
+    uint8_t n;
+    for (n = 8; n < sln-5; n++)
+      fprintf(stderr, " %02hx", (unsigned short)*(unsigned char*)(buf+n));
+  }
+  if (isprint(buf[sln-5]) && isprint(buf[sln-4]) && isprint(buf[sln-3]))
+    fprintf(stderr, " %3.3s", buf+sln-5);
+  else
+    fprintf(stderr, " %02hx %02hx %02hx",
+	    (unsigned short)*(unsigned char*)(buf+sln-5),
+	    (unsigned short)*(unsigned char*)(buf+sln-4),
+	    (unsigned short)*(unsigned char*)(buf+sln-3));
+  fprintf(stderr, " %02hx %02hx\n",
+	  (unsigned short)*(unsigned char*)(buf+sln-2),
+	  (unsigned short)*(unsigned char*)(buf+sln-1));
+#endif
+
+  return sln;
+}
+
+
+/*****************************************************************************
+ Return non-zero if the sentence of length sln at buf duplicates the
+ last sentence accepted, as recorded in drp, and record it as the last
+ sentence otherwise. At the start of a response, a sentence with index
+ zero is never a duplicate, since a response may start with the same
+ content as the previous one, e.g. when reading erased memory.
+ *****************************************************************************/
+static int data_duplicate(data_rsp_t *drp, const char *buf, int sln) {
+  if (sln == drp->lsl && (drp->rsi > 0 || buf[8] != 0) &&
+      memcmp(buf, drp->ls, sln) == 0) {
+    drp->ndup++;
+    return 1;
+  }
+  memcpy(drp->ls, buf, sln);
+  drp->lsl = sln;
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Receive the $LOG102 sentences in response to a data retrieve command.
+ The records received are decoded into gfxp, and copied unchanged into
+ rawp, if either is not NULL. A sentence duplicating the one before it
+ is discarded. If a sentence is corrupted, the response is abandoned
+ with that sentence left unconsumed, and the state of the response
+ left in drp, so that the remainder of the response can be skipped.
+ *****************************************************************************/
+static int get_data_sentences(rtk_session_t *sp, short int fxtyp, int nfix,
+			      gps_fix_t *gfxp, char *rawp, int nfxt,
+			      int nfxb, data_rsp_t *drp) {
+  struct timespec t0, dl;
+  const char *buf;
+  fix_decoder_t dcdp;
+  long int tmt;
+  int sln, fsz, nrec;
+
+  /* Select the decoder for the record type once for the response */
+  if ((fsz = fix_size(fxtyp)) == 0) {
+    sp->rcerrno = RCERROR_PARSE;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+  dcdp = fix_decoder(fxtyp);
+  drp->rsi = 0;
+  drp->nfx = 0;
+
+  /* Each sentence after the first is timed from the previous one */
+  deadline_set(&t0, 0);
+
   /* Continue reading until all requested fixes received */
-  while (fn < nfix) {
-    /* Try to get initial $LOG102 prefix and check result for errors. */
-    rn = serial_read_discard(fd, buf, 512, bn, "$LOG102", tmt);
-    if (rn < 0) {
-      rcerrno = RCERROR_SYS;
-      rcerrln = __LINE__;
+  while (drp->nfx < nfix) {
+    /* Set deadline for receipt of the complete sentence. The first
+       sentence may only follow once the logger has acted on the data
+       retrieve command, rather than at the rate at which sentences
+       are streamed. */
+    tmt = rtt_timeout(&sp->gaprt, 1000);
+    if (drp->rsi == 0 && rtt_timeout(&sp->cmdrt, 1000) > tmt)
+      tmt = rtt_timeout(&sp->cmdrt, 1000);
+    deadline_set(&dl, tmt);
+
+    sln = read_data_sentence(sp, (nfix - drp->nfx)*fsz, &dl);
+    if (sln < 0)
       return -1;
-    }
-    if (rn == 0 && buf[0] == '\0') {
-      rcerrno = RCERROR_NORSP;
-      rcerrln = __LINE__;
+    buf = serial_peek(sp->tp);
+
+    /* Signal error if response string indicates invalid request,
+       consuming the response so that the request can be retried */
+    if (sln == 11) {
+      serial_consume(sp->tp, 11);
+      sp->rcerrno = RCERROR_INVLDCMD;
+      sp->rcerrln = __LINE__;
       return -1;
     }
-    if (rn == 0 && buf[0] != '\0') {
-      rcerrno = RCERROR_PARSE;
-      rcerrln = __LINE__;
+
+    /* Verify checksum on current sentence */
+    if (!verify_array_checksum(buf, sln-2)) {
+      sp->rcerrno = RCERROR_CHECKSUM;
+      sp->rcerrln = __LINE__;
       return -1;
     }
-    bn = rn;
-
-    /* If received buffer doesn't include sentence length byte, try
-       to read the necessary additional bytes, and check result for
-       errors. */
-    if (bn < 11) {
-      rn = serial_read_repeat(fd, buf + bn, 11 - bn, tmt);
-      if (rn < 0) {
-	rcerrno = RCERROR_SYS;
-	rcerrln = __LINE__;
-	return -1;
-      }
-      if (rn == 0) {
-	rcerrno = RCERROR_PARSE;
-	rcerrln = __LINE__;
-	return -1;
-      }
-      bn += rn;
+    if (drp->rsi > 0)
+      rtt_sample(&sp->gaprt, &t0);
+    deadline_set(&t0, 0);
+
+    /* Discard a repeated sentence */
+    if (data_duplicate(drp, buf, sln)) {
+      serial_consume(sp->tp, sln);
+      continue;
     }
 
-    /* Signal error if response string indicates invalid request */
-    if (strncmp(buf, "$LOG102,0*6B", 11) == 0) {
-      rcerrno = RCERROR_INVLDCMD;
-      rcerrln = __LINE__;
+    /* Check response sentence index number. Sentences that are out of
+       order can not be placed, since the number of fixes in each is
+       not known. An index of zero is the start of the response to a
+       subsequent pipelined request, so that sentences at the end of
+       this response have been lost. */
+    if ((uint8_t)buf[8] != drp->rsi) {
+      sp->rcerrno = RCERROR_SEQUENCE;
+      sp->rcerrln = __LINE__;
+      return -1;
+    }
+    drp->rsi++;
+
+    /* Signal error if the sentence payload is not a whole number of
+       records, or contains more fixes than expected */
+    nrec = (uint8_t)buf[10]/fsz;
+    if ((uint8_t)buf[10] != nrec*fsz || nrec > nfix - drp->nfx) {
+      sp->rcerrno = RCERROR_PARSE;
+      sp->rcerrln = __LINE__;
       return -1;
     }
 
-    /* Check response sentence index number */
-    if (gcwrnfp != NULL && rsi != buf[8]) {
-      char wstr[128];
+    /* Copy the records, or decode them into the output fixes */
+    if (rawp != NULL)
+      memcpy(rawp + drp->nfx*fsz, buf+11, nrec*fsz);
+    if (gfxp != NULL)
+      dcdp(sp, buf+11, nrec, gfxp+drp->nfx);
 
-      sprintf(wstr, "received sentence %d while expecting %d", buf[8], rsi);
-      gcwrnfp(wstr,__LINE__, __FILE__);
-    }
-    rsi++;
-
-    /* Get byte count for remainder of sentence */
-    rbc = buf[10];
-    /* Compute sentence length (up to end of "\r\n") */
-    sln = 11 + rbc + 5;
-
-    /* If number of bytes read is less than sentence length, try to
-       read remainder of sentence, and check result for errors. */
-    if (bn < sln) {
-      rn = serial_read_repeat(fd, buf + bn, sln - bn, tmt);
-      if (rn < 0) {
-	rcerrno = RCERROR_SYS;
-	rcerrln = __LINE__;
-	return -1;
-      }
-      if (rn == 0) {
-	rcerrno = RCERROR_PARSE;
-	rcerrln = __LINE__;
-	return -1;
-      }
-      bn += rn;
-    }
+    /* Increment current output fix count */
+    drp->nfx += nrec;
 
-#ifdef DEBUG
-    fprintf(stderr, "<<< %8.8s", buf);
-    {
-      uint8_t n;
-      for (n = 8; n < sln-5; n++)
-	fprintf(stderr, " %02hx", (unsigned short)*(unsigned char*)(buf+n));
+    /* Call progress callback function pointer if provided */
+    if (sp->gdpfp != NULL)
+      sp->gdpfp(sp, nfxt, nfxb+drp->nfx);
+
+    /* Consume current sentence, leaving any following bytes in the
+       input buffer */
+    serial_consume(sp->tp, sln);
+  }
+
+  return drp->nfx;
+}
+
+
+/*****************************************************************************
+ Skip the remainder of a log data response abandoned at a corrupted
+ sentence, as recorded in drp, with nrb bytes of fixes not received,
+ so that the response to the next pipelined request can be received.
+ Every sentence skipped, including corrupted ones, must continue the
+ sequence of sentence indices and fixes of the abandoned response, so
+ that the start of the next response can not be mistaken. Returns -1
+ if this can not be established, in which case the input should be
+ discarded.
+ *****************************************************************************/
+static int data_resync(rtk_session_t *sp, data_rsp_t *drp, int nrb) {
+  struct timespec dl;
+  const char *buf;
+  int sln, cksm;
+
+  while (1) {
+    deadline_set(&dl, rtt_timeout(&sp->gaprt, 1000));
+    if ((sln = read_data_sentence(sp, nrb, &dl)) < 0)
+      return -1;
+    buf = serial_peek(sp->tp);
+
+    /* The next response starts once all fixes are accounted for */
+    if (sln == 11 || (buf[8] == 0 && drp->rsi > 0))
+      return (nrb == 0)?0:-1;
+
+    /* The length of a corrupted sentence is trusted only as far as
+       the check against the fixes remaining, and only its first byte
+       is consumed, so that the next sentence is found even if the
+       length is wrong */
+    cksm = verify_array_checksum(buf, sln-2);
+    if (cksm && data_duplicate(drp, buf, sln)) {
+      serial_consume(sp->tp, sln);
+      continue;
     }
-    if (isprint(buf[sln-5]) && isprint(buf[sln-4]) && isprint(buf[sln-3]))
-      fprintf(stderr, " %3.3s", buf+sln-5);
-    else
-      fprintf(stderr, " %02hx %02hx %02hx",
-	      (unsigned short)*(unsigned char*)(buf+sln-5),
-	      (unsigned short)*(unsigned char*)(buf+sln-4),
-	      (unsigned short)*(unsigned char*)(buf+sln-3));
-    fprintf(stderr, " %02hx %02hx\n",
-	    (unsigned short)*(unsigned char*)(buf+sln-2),
-	    (unsigned short)*(unsigned char*)(buf+sln-1));
-#endif
+    if ((uint8_t)buf[8] != drp->rsi || (uint8_t)buf[10] > nrb)
+      return -1;
+    drp->rsi++;
+    nrb -= (uint8_t)buf[10];
+    serial_consume(sp->tp, (cksm)?sln:1);
+  }
+}
 
-    /* Verify checksum on current sentence */
-    if (!verify_array_checksum(buf, sln-2)) {
-      rcerrno = RCERROR_CHECKSUM;
-      rcerrln = __LINE__;
+
+/*****************************************************************************
+ Send a request for nfix fixes of logfile data starting at logger
+ memory address memp, for record type fxtyp.
+ *****************************************************************************/
+static int send_data_request(rtk_session_t *sp, int memp, short int fxtyp,
+			     int nfix) {
+  char cmd[32];
+
+  /* Set up data retrieve command */
+  sprintf(cmd, "$PROY102,%d,%hd,%hd*", memp, fxtyp, nfix);
+  /* Send command */
+  if (send_cmd(sp, cmd) < 0) {
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Get nfix fixes of logfile data starting at logger memory address
+ memp, for record type fxtyp. If part of the response is corrupted or
+ lost, the request is repeated, up to the number of consecutive
+ failures allowed for file data.
+ *****************************************************************************/
+int get_data(rtk_session_t *sp, int memp, short int fxtyp, int nfix,
+	     gps_fix_t *gfxp, int nfxt, int nfxb) {
+  data_rsp_t drs;
+  int fn, ntry = 0;
+
+  drs.ndup = 0;
+  drs.lsl = 0;
+  do {
+    if (send_data_request(sp, memp, fxtyp, nfix) < 0)
       return -1;
+
+    fn = get_data_sentences(sp, fxtyp, nfix, gfxp, NULL, nfxt, nfxb, &drs);
+    /* Cancel any remaining input expectation, e.g. after an error, so
+       that responses to subsequent commands are not delayed */
+    serial_expect(sp->tp, 0);
+    if (fn >= 0 || (sp->rcerrno != RCERROR_CHECKSUM &&
+		    sp->rcerrno != RCERROR_SEQUENCE &&
+		    sp->rcerrno != RCERROR_PARSE))
+      break;
+    data_discard(sp);
+    drs.lsl = 0;
+  } while (++ntry < XFER_MXFAIL);
+
+  return fn;
+}
+
+
+/*****************************************************************************
+ Initialise log data transfer state xfp for up to nwin outstanding
+ requests, given logger memory sector size sctrsz, or zero if unknown.
+ The initial request size is the largest allowed, or a single sector
+ if smaller, and is reduced if the logger rejects it.
+ *****************************************************************************/
+void xfer_init(xfer_t *xfp, int nwin, unsigned int sctrsz) {
+  xfp->nwin = (nwin < 1)?1:(nwin > XFER_MXWIN)?XFER_MXWIN:nwin;
+  xfp->sctrsz = sctrsz;
+  xfp->rqmx = XFER_MXRQ;
+  if (sctrsz >= XFER_MNRQ && sctrsz < XFER_MXRQ)
+    xfp->rqmx = sctrsz;
+  xfp->rqsz = xfp->rqmx;
+  xfp->nacc = 0;
+  xfp->nfail = 0;
+  xfp->rqok = 0;
+  xfp->nrtry = 0;
+  xfp->ndup = 0;
+}
+
+
+/*****************************************************************************
+ Return the number of fixes to request from log file lgfp, starting
+ at fix number srn. The request is no larger than the current request
+ size, and ends at a sector boundary rather than extending into the
+ following sector, so that after the first request of a file, requests
+ are aligned with sectors.
+ *****************************************************************************/
+static int xfer_chunk(const xfer_t *xfp, const logfile_t *lgfp, int srn) {
+  int fsz, memp, end, bnd, n;
+
+  fsz = fix_size(lgfp->fxtyp);
+  memp = lgfp->memp + srn*fsz;
+  end = memp + xfp->rqsz;
+  if (xfp->sctrsz > 0) {
+    bnd = end - end % xfp->sctrsz;
+    if (bnd - memp >= fsz)
+      end = bnd;
+  }
+  n = (end - memp)/fsz;
+  if (n < 1)
+    n = 1;
+  if (n > lgfp->nfix - srn)
+    n = lgfp->nfix - srn;
+
+  return n;
+}
+
+
+/*****************************************************************************
+ Adjust the request size of xfp after a request of nbyt bytes succeeds
+ (ok non-zero) or fails with error rcerr. The size is halved on
+ failure. A logger may ignore or truncate, rather than reject, a
+ request that is too large, so that after any failure of a request
+ larger than every request accepted so far, the size is not increased
+ beyond the halved size, or the largest size accepted, again. After a
+ run of successful requests, the size is doubled, up to that limit.
+ Returns -1 if there have been too many consecutive failures, or if
+ the failure was not due to the request.
+ *****************************************************************************/
+static int xfer_adjust(xfer_t *xfp, int nbyt, int ok, rcerror_t rcerr) {
+  if (ok) {
+    if (nbyt > xfp->rqok)
+      xfp->rqok = nbyt;
+    xfp->nfail = 0;
+    if (++xfp->nacc >= 8 && xfp->rqsz < xfp->rqmx) {
+      xfp->rqsz = (2*xfp->rqsz < xfp->rqmx)?2*xfp->rqsz:xfp->rqmx;
+      xfp->nacc = 0;
     }
+    return 0;
+  }
 
-    /* Set sn to byte number in sentence of start of fix data */
-    sn = 11;
-    /* Loop over all fixes in current sentence */
-    while (sn < sln - 5) {
-      /* Signal error if more fixes than expected received */
-      if (fn >= nfix) {
-	rcerrno = RCERROR_PARSE;
-	rcerrln = __LINE__;
-	return -1;
-      }
+  if (++xfp->nfail > XFER_MXFAIL || rcerr == RCERROR_SYS ||
+      rcerr == RCERROR_MEMALLOC)
+    return -1;
+  xfp->rqsz /= 2;
+  if (xfp->rqsz < XFER_MNRQ)
+    xfp->rqsz = XFER_MNRQ;
+  if (nbyt > xfp->rqok || rcerr == RCERROR_INVLDCMD)
+    xfp->rqmx = (xfp->rqsz > xfp->rqok)?xfp->rqsz:xfp->rqok;
+  xfp->nacc = 0;
+
+  return 0;
+}
 
-      /* Initialise current output fix to zero */
-      memset(gfxp+fn, 0, sizeof(gps_fix_t));
-      /* Copy current sentence fix into current output fix */
-      memcpy(gfxp+fn, buf+sn, fix_size(fxtyp));
 
-#ifdef WORDS_BIGENDIAN
-      /* If necessary, swap endianness of float values */
-      bswap_32(*(__uint32_t*)(char*)&gfxp[fn].lat);
-      bswap_32(*(__uint32_t*)(char*)&gfxp[fn].lng);
-      if (fxtyp > 0)
-	bswap_32(*(__uint32_t*)(char*)&gfxp[fn].alt);
-      if (fxtyp > 1)
-	bswap_32(*(__uint32_t*)(char*)&gfxp[fn].vel);
-#endif
+/*****************************************************************************
+ Return the index of the log file, of the nfile log files described by
+ lgflp, that holds fix number *fnp, counted from the start of the first
+ of them, and set *fnp to the number of the fix within that log file.
+ *****************************************************************************/
+static int file_locate(const logfile_t *lgflp, int nfile, int *fnp) {
+  int n;
 
-      /* Do sanity check on fix values, calling warning callback
-	 function pointer, if provided, when errors encountered. The
-	 unkwn field of the gps_fix_t structure is used to signal
-	 valid or invalid fixes. */
-      gfxp[fn].unkwn = 0;
-      if (gfxp[fn].hour > 23 || gfxp[fn].min > 59 || gfxp[fn].sec > 59) {
-	gfxp[fn].unkwn = 1;
-	if (gcwrnfp != NULL)
-	  gcwrnfp("invalid time value", __LINE__, __FILE__);
-      }
-      if (isnan(gfxp[fn].lat) || isinf(gfxp[fn].lat)) {
-	gfxp[fn].unkwn = 1;
-	if (gcwrnfp != NULL)
-	  gcwrnfp("latitude with inf/NaN value", __LINE__, __FILE__);
-      }
-      if (isnan(gfxp[fn].lng) || isinf(gfxp[fn].lng)) {
-	gfxp[fn].unkwn = 1;
-	if (gcwrnfp != NULL)
-	  gcwrnfp("longitude with inf/NaN value", __LINE__, __FILE__);
+  for (n = 0; n < nfile - 1 && *fnp >= lgflp[n].nfix; n++)
+    *fnp -= lgflp[n].nfix;
+
+  return n;
+}
+
+
+/*****************************************************************************
+ Return the offset, in bytes, of the record of fix number fn, counted
+ from the start of the first of the nfile log files described by lgflp,
+ with the records of each log file following those of the one before.
+ *****************************************************************************/
+static long int file_offset(const logfile_t *lgflp, int nfile, int fn) {
+  long int off = 0;
+  int n;
+
+  for (n = 0; n < nfile - 1 && fn >= lgflp[n].nfix; n++) {
+    off += (long int)lgflp[n].nfix*fix_size(lgflp[n].fxtyp);
+    fn -= lgflp[n].nfix;
+  }
+
+  return off + (long int)fn*fix_size(lgflp[n].fxtyp);
+}
+
+
+/*****************************************************************************
+ Get the records of the nfile log files described by lgflp, from fix
+ number fn0 onwards, with fixes numbered from the start of the first
+ log file, using and updating transfer state xfp. The records are
+ decoded into gfxp, if it is not NULL, and passed unchanged, in order,
+ to the raw data callback function pointer, if provided. Up to
+ xfp->nwin data requests are kept outstanding, so that the logger does
+ not wait for each request after responding to the previous one, and
+ requests continue from one log file to the next without waiting for
+ the responses to the previous one. If a request fails, its range of
+ fixes is requested again, with a smaller request size, once the rest
+ of its response has been skipped. If that is not possible,
+ outstanding responses are discarded, and the data is requested again
+ from the first fix not yet received.
+ *****************************************************************************/
+static int get_file_records(rtk_session_t *sp, const logfile_t *lgflp,
+			    int nfile, gps_fix_t *gfxp, int fn0,
+			    xfer_t *xfp) {
+  const logfile_t *lgfp;
+  data_rsp_t drs;
+  rcerror_t rcerr;
+  int rqs[XFER_MXWIN], rqn[XFER_MXWIN];
+  int rts[XFER_MXRTRY], rtn[XFER_MXRTRY];
+  int fsz, s, n, crn, rrn, trn = fn0, srn = fn0, nrcv = fn0;
+  int nout = 0, nrt = 0, nwin, nfix = 0, rbf = fn0;
+  char *rawb = NULL;
+  long int rbo;
+
+  for (n = 0; n < nfile; n++)
+    nfix += lgflp[n].nfix;
+  drs.ndup = 0;
+  drs.lsl = 0;
+
+  /* Records passed to the raw data callback are held, from the first
+     fix not yet passed on (rbf, at offset rbo), until all of the
+     records preceding them have been received */
+  if (sp->gdrfp != NULL && (rawb = malloc(XFER_RAWSZ)) == NULL) {
+    sp->rcerrno = RCERROR_MEMALLOC;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+  rbo = file_offset(lgflp, nfile, rbf);
+
+  /* Call progress callback function pointer if provided */
+  if (sp->gdpfp != NULL)
+    sp->gdpfp(sp, nfix, fn0);
+
+  while (trn < nfix) {
+
+    /* Send requests until the window is full, requesting the ranges
+       of failed requests before continuing from fix srn. The range of
+       each request is recorded, since the request size may change
+       before the response is received, and responses are matched to
+       requests by their order. Until a request has been accepted,
+       only one is sent at a time. A request does not extend beyond
+       the end of a log file, or beyond the end of the raw data
+       buffer. */
+    nwin = (xfp->rqok > 0)?xfp->nwin:1;
+    while (nout < nwin && (nrt > 0 || srn < nfix)) {
+      s = (nrt > 0)?rts[0]:srn;
+      n = s;
+      lgfp = lgflp + file_locate(lgflp, nfile, &n);
+      fsz = fix_size(lgfp->fxtyp);
+      crn = xfer_chunk(xfp, lgfp, n);
+      if (nrt > 0 && crn > rtn[0])
+	crn = rtn[0];
+      if (rawb != NULL &&
+	  file_offset(lgflp, nfile, s) + crn*fsz - rbo > XFER_RAWSZ) {
+	/* Move the records not yet passed on to the start of the
+	   buffer, and if there is still no space, wait for them to be
+	   passed on */
+	if (trn > rbf) {
+	  memmove(rawb, rawb + file_offset(lgflp, nfile, trn) - rbo,
+		  file_offset(lgflp, nfile, srn) -
+		  file_offset(lgflp, nfile, trn));
+	  rbf = trn;
+	  rbo = file_offset(lgflp, nfile, rbf);
+	}
+	crn = (XFER_RAWSZ - (file_offset(lgflp, nfile, s) - rbo))/fsz;
+	if (crn > xfer_chunk(xfp, lgfp, n))
+	  crn = xfer_chunk(xfp, lgfp, n);
+	if (nrt > 0 && crn > rtn[0])
+	  crn = rtn[0];
+	if (crn < 1)
+	  break;
       }
-      if (isnan(gfxp[fn].alt) || isinf(gfxp[fn].alt)) {
-	gfxp[fn].unkwn = 1;
-	if (gcwrnfp != NULL)
-	  gcwrnfp("altitude with inf/NaN value", __LINE__, __FILE__);
+      if (nrt > 0) {
+	rts[0] += crn;
+	if ((rtn[0] -= crn) == 0) {
+	  nrt--;
+	  memmove(rts, rts + 1, nrt*sizeof(int));
+	  memmove(rtn, rtn + 1, nrt*sizeof(int));
+	}
+      } else
+	srn += crn;
+      if (send_data_request(sp, lgfp->memp + n*fsz, lgfp->fxtyp, crn) < 0) {
+	if (nout > 0)
+	  data_discard(sp);
+	xfp->ndup += drs.ndup;
+	free(rawb);
+	return -1;
       }
-      if (isnan(gfxp[fn].vel) || isinf(gfxp[fn].vel)) {
-	gfxp[fn].unkwn = 1;
-	if (gcwrnfp != NULL)
-	  gcwrnfp("velocity with inf/NaN value", __LINE__, __FILE__);
+      rqs[nout] = s;
+      rqn[nout] = crn;
+      nout++;
+    }
+
+    s = rqs[0];
+    crn = rqn[0];
+    n = s;
+    lgfp = lgflp + file_locate(lgflp, nfile, &n);
+    fsz = fix_size(lgfp->fxtyp);
+    rrn = get_data_sentences(sp, lgfp->fxtyp, crn,
+			     (gfxp != NULL)?gfxp + s:NULL,
+			     (rawb != NULL)?
+			     rawb + (file_offset(lgflp, nfile, s) - rbo):NULL,
+			     nfix, nrcv, &drs);
+    serial_expect(sp->tp, 0);
+    nout--;
+    memmove(rqs, rqs + 1, nout*sizeof(int));
+    memmove(rqn, rqn + 1, nout*sizeof(int));
+    if (rrn >= 0 && rrn != crn) {
+      sp->rcerrno = RCERROR_PARSE;
+      sp->rcerrln = __LINE__;
+      rrn = -1;
+    }
+    if (rrn < 0) {
+      rcerr = sp->rcerrno;
+      if (xfer_adjust(xfp, crn*fsz, 0, rcerr) < 0) {
+	if (nout > 0 || rcerr != RCERROR_INVLDCMD)
+	  data_discard(sp);
+	xfp->ndup += drs.ndup;
+	free(rawb);
+	return -1;
       }
-	/* Still need to determine actual range */
-      if (gfxp[fn].lat < -M_PI || gfxp[fn].lat > 2*M_PI) {
-	gfxp[fn].unkwn = 1;
-	if (gcwrnfp != NULL)
-	  gcwrnfp("out of range latitude", __LINE__, __FILE__);
+      xfp->nrtry++;
+      /* Rejection of a request that is too large is expected while
+	 the request size is being determined */
+      if (sp->gcwrnfp != NULL && rcerr != RCERROR_INVLDCMD) {
+	char wstr[128];
+
+	sprintf(wstr, "request for %d fixes failed, retrying with request "
+		"size %d", crn, xfp->rqsz);
+	sp->gcwrnfp(sp, wstr,__LINE__, __FILE__);
       }
-      if (gfxp[fn].lng < -M_PI || gfxp[fn].lng > M_PI) {
-	gfxp[fn].unkwn = 1;
-	if (gcwrnfp != NULL)
-	   gcwrnfp("out of range longitude", __LINE__, __FILE__);
+      /* A rejected request has no further response, and the rest of
+	 a response with a corrupted sentence can be skipped, so that
+	 the outstanding responses can still be received, and only the
+	 failed range is requested again. Any other failure may leave
+	 part of the response still to arrive, so that all outstanding
+	 responses are discarded. */
+      if (nout > 0 && nrt < XFER_MXRTRY &&
+	  (rcerr == RCERROR_INVLDCMD ||
+	   (rcerr == RCERROR_CHECKSUM &&
+	    data_resync(sp, &drs, (crn - drs.nfx)*fsz) == 0))) {
+	for (n = nrt; n > 0 && rts[n-1] > s; n--) {
+	  rts[n] = rts[n-1];
+	  rtn[n] = rtn[n-1];
+	}
+	rts[n] = s;
+	rtn[n] = crn;
+	nrt++;
+      } else {
+	if (nout > 0 || rcerr != RCERROR_INVLDCMD) {
+	  data_discard(sp);
+	  drs.lsl = 0;
+	}
+	srn = nrcv = trn;
+	nout = nrt = 0;
       }
-
-      /* Increment current output fix count */
-      fn++;
-
-      /* Call progress callback function pointer if provided */
-      if (gdpfp != NULL)
-	gdpfp(nfxt, nfxb+fn);
-
-      /* Increment current sentence fix byte count */
-      sn += fix_size(fxtyp);
+    } else {
+      xfer_adjust(xfp, crn*fsz, 1, RCERROR_NULL);
+      nrcv += rrn;
     }
 
-    /* If buffer contains bytes beyond current sentence, move them to
-       the start of the buffer and set the new buffer content
-       length. */
-    if (bn > sln) {
-      memmove(buf, buf + sln, bn - sln);
-      bn -= sln;
-    } else
-      bn = 0;
+    /* Call completion callback function pointers if provided, for the
+       fixes preceding the first not yet received */
+    n = srn;
+    for (s = 0; s < nout; s++) {
+      if (rqs[s] < n)
+	n = rqs[s];
+    }
+    if (nrt > 0 && rts[0] < n)
+      n = rts[0];
+    if (n > trn) {
+      if (sp->gdcfp != NULL && gfxp != NULL)
+	sp->gdcfp(sp, gfxp + trn, trn, n - trn);
+      if (rawb != NULL)
+	sp->gdrfp(sp, rawb + file_offset(lgflp, nfile, trn) - rbo,
+		  file_offset(lgflp, nfile, n) -
+		  file_offset(lgflp, nfile, trn));
+      trn = n;
+    }
   }
+  xfp->ndup += drs.ndup;
+  free(rawb);
 
-  return fn;
+  return nfix;
 }
 
 
 /*****************************************************************************
- Get full logfile data for file described by lgfp.
+ Get full logfile data for file described by lgfp, using and updating
+ transfer state xfp. The first fn0 fixes are already in gfxp (from an
+ earlier, interrupted retrieval), and are not requested again. As the
+ fixes following them are received, they are passed to the completion
+ callback function pointer, if provided, in order and exactly once.
  *****************************************************************************/
-int get_file_data(int fd, const logfile_t *lgfp, gps_fix_t *gfxp) {
-  const int mxfxn = 108;
-  int crn, rrn, trn = 0;
+int get_file_data(rtk_session_t *sp, const logfile_t *lgfp,
+		  gps_fix_t *gfxp, int fn0, xfer_t *xfp) {
+  return get_file_records(sp, lgfp, 1, gfxp, fn0, xfp);
+}
 
-  /* Call progress callback function pointer if provided */
-  if (gdpfp != NULL)
-    gdpfp(lgfp->nfix, 0);
 
-  while (trn < lgfp->nfix) {
+/*****************************************************************************
+ Return the number of log files, at the start of the nfile log files
+ described by lgflp, that can be retrieved together by get_files_data.
+ These are the log files that follow each other in logger memory, and
+ have the same record type, so that a data request may span more than
+ one of them.
+ *****************************************************************************/
+int files_contiguous(const logfile_t *lgflp, int nfile) {
+  int n;
 
-    if (lgfp->nfix - trn > mxfxn)
-      crn = mxfxn;
-    else
-      crn = lgfp->nfix - trn;
+  for (n = 1; n < nfile; n++) {
+    if (lgflp[n].fxtyp != lgflp[0].fxtyp ||
+	lgflp[n].memp != lgflp[n-1].memp +
+	lgflp[n-1].nfix*fix_size(lgflp[n-1].fxtyp))
+      break;
+  }
 
-    rrn = get_data(fd, lgfp->memp + trn*fix_size(lgfp->fxtyp), lgfp->fxtyp,
-		   crn, gfxp + trn, lgfp->nfix, trn);
-    if (rrn < 0)
-      return -1;
+  return (nfile > 0)?n:0;
+}
 
-    if (rrn != crn) {
-      rcerrno = RCERROR_PARSE;
-      rcerrln = __LINE__;
-      return -1;
-    }
 
-    trn += rrn;
+/*****************************************************************************
+ Get full logfile data for the nfile log files described by lgflp,
+ which must satisfy files_contiguous, into gfxp, one log file after
+ another, using and updating transfer state xfp. The log files are
+ retrieved as a single sweep of logger memory, with requests crossing
+ the boundaries between them. As fixes are received, they are passed
+ to the completion callback function pointer, if provided, with fix
+ numbers counted from the start of the first log file.
+ *****************************************************************************/
+int get_files_data(rtk_session_t *sp, const logfile_t *lgflp, int nfile,
+		   gps_fix_t *gfxp, xfer_t *xfp) {
+  logfile_t lgfl;
+  int n;
+
+  lgfl = lgflp[0];
+  for (n = 1; n < nfile; n++)
+    lgfl.nfix += lgflp[n].nfix;
+
+  return get_file_records(sp, &lgfl, 1, gfxp, 0, xfp);
+}
+
+
+/*****************************************************************************
+ Get the records of the nfile log files described by lgflp, as stored
+ in logger memory, passing them in order to the raw data callback
+ function pointer, using and updating transfer state xfp. The log
+ files are retrieved as a single sequence of data requests, with the
+ requests for each run of log files that satisfies files_contiguous
+ crossing the boundaries between them, as in get_files_data.
+ *****************************************************************************/
+int get_files_raw(rtk_session_t *sp, const logfile_t *lgflp, int nfile,
+		  xfer_t *xfp) {
+  logfile_t *sgmp;
+  int n, k, m, nsgm = 0, rv = 0;
+
+  if ((sgmp = malloc((nfile+1)*sizeof(logfile_t))) == NULL) {
+    sp->rcerrno = RCERROR_MEMALLOC;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+  for (n = 0; n < nfile; n += m) {
+    m = files_contiguous(lgflp + n, nfile - n);
+    sgmp[nsgm] = lgflp[n];
+    for (k = 1; k < m; k++)
+      sgmp[nsgm].nfix += lgflp[n+k].nfix;
+    if (sgmp[nsgm].nfix > 0)
+      nsgm++;
   }
+  if (nsgm > 0)
+    rv = get_file_records(sp, sgmp, nsgm, NULL, 0, xfp);
+  free(sgmp);
 
-  return lgfp->nfix;
+  return rv;
 }
 
 
 /*****************************************************************************
- Write the logger/NMEA output mode set command to file descriptor fd.
+ Write the logger/NMEA output mode set command to session sp.
  *****************************************************************************/
-int set_mode(int fd, short int log, short int out) {
+int set_mode(rtk_session_t *sp, short int log, short int out) {
   char cmd[32];
   char rsp[64] = "";
   char *lp = NULL;
 
   sprintf(cmd, "$PROY103,%hd,%hd*", (log == 0)?0:1, (out == 0)?0:1);
-  lp = get_cmd_response(fd, cmd, "$LOG103", rsp, 64);
+  lp = cmd_response(sp, cmd, "$LOG103", rsp, 64, CMD_MNTMT);
   if (lp == NULL)
     return -1;
 
   if (strcmp(lp, "$LOG103,1*6B\r\n") != 0) {
-    rcerrno = RCERROR_UNXPRSP;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_UNXPRSP;
+    sp->rcerrln = __LINE__;
     return -1;
   }
 
@@ -938,43 +1897,134 @@ int set_mode(int fd, short int log, short int out) {
 
 
 /*****************************************************************************
- Set status parameters via file descriptor fd.
+ Set status parameters via session sp.
  *****************************************************************************/
-int set_status(int fd, const status_t *status) {
+int set_status(rtk_session_t *sp, const status_t *status) {
   char cmd[32];
   char rsp[64] = "";
   char *lp = NULL;
 
   sprintf(cmd, "$PROY104,0,%hd,%hd,%hd*", status->sntvl, status->fxtyp,
 	  status->mfowm);
-  lp = get_cmd_response(fd, cmd, "$LOG104", rsp, 64);
+  lp = cmd_response(sp, cmd, "$LOG104", rsp, 64, CMD_MNTMT);
   if (lp == NULL)
     return -1;
 
   if (strcmp(lp, "$LOG104,1*6C\r\n") != 0) {
-    rcerrno = RCERROR_UNXPRSP;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_UNXPRSP;
+    sp->rcerrln = __LINE__;
+    return -1;
+  }
+
+  return 1;
+}
+
+
+/*****************************************************************************
+ Switch the logger, and then session sp, to line speed speed, using
+ the SiRF NMEA serial port command, and check that the logger responds
+ at the new speed.
+ *****************************************************************************/
+int set_line_speed(rtk_session_t *sp, unsigned int speed) {
+  struct timespec dl;
+  char cmd[64];
+  char rsp[256] = "";
+  int sln;
+
+  /* Unlike the PROY commands, SiRF input messages require the standard
+     NMEA checksum, excluding the leading '$' and the trailing '*' */
+  sln = sprintf(cmd, "$PSRF100,1,%u,8,1,0*", speed);
+  sprintf(cmd + sln, "%02X\r\n", array_checksum(cmd + 1, sln - 2));
+
+#ifdef DEBUG
+  fprintf(stderr, ">>> %s", cmd);
+#endif
+
+  if (serial_write(sp->tp, cmd, sln + 4) != sln + 4 ||
+      transport_speed(sp->tp, speed) < 0) {
+    sp->rcerrno = RCERROR_SYS;
+    sp->rcerrln = __LINE__;
     return -1;
   }
 
+  /* Allow time for the receiver to switch, and discard any input
+     received during the switch */
+  deadline_set(&dl, 100);
+  deadline_sleep(&dl);
+  while (serial_drain(sp->tp) > 0)
+    serial_consume(sp->tp, serial_buffered(sp->tp));
+  serial_consume(sp->tp, serial_buffered(sp->tp));
+
+  if (get_cmd_response(sp, "$PROY108*", "$LOG108", rsp, 256) == NULL)
+    return -1;
+
   return 1;
 }
 
 
 /*****************************************************************************
- Write the memory erase command to file descriptor fd.
+ Determine the line speed of the logger by trying each of the nspd
+ speeds in spdl in turn, sending a status request and waiting at most
+ tmt ms for any sentence with a valid checksum. Returns the index in
+ spdl of the detected speed, with session sp set to that speed, or
+ -1 if no speed was detected.
  *****************************************************************************/
-int set_memory_erase(int fd) {
+int detect_line_speed(rtk_session_t *sp, const unsigned int *spdl, int nspd,
+		      long int tmt) {
+  struct timespec dl;
+  ssize_t rn;
+  int n, vld;
+
+  for (n = 0; n < nspd; n++) {
+    if (transport_speed(sp->tp, spdl[n]) < 0) {
+      sp->rcerrno = RCERROR_SYS;
+      sp->rcerrln = __LINE__;
+      return -1;
+    }
+    /* Discard input received at the previous speed */
+    while (serial_drain(sp->tp) > 0)
+      serial_consume(sp->tp, serial_buffered(sp->tp));
+    serial_consume(sp->tp, serial_buffered(sp->tp));
+
+    if (send_cmd(sp, "$PROY108*") < 0)
+      return -1;
+    /* Any valid sentence, including GPS mouse mode output, confirms
+       the speed. At the wrong speed, input is garbled, and sentences,
+       if any are found, fail the checksum. */
+    deadline_set(&dl, tmt);
+    vld = 0;
+    while (!vld && (rn = serial_read_string(sp->tp, "$", "\r\n", 256,
+					    &dl)) > 0) {
+      vld = verify_array_checksum(serial_peek(sp->tp), rn - 2);
+      serial_consume(sp->tp, rn);
+    }
+    /* When GPS mouse mode is disabled, the only valid sentence is the
+       response, which is consumed so that a following get_status
+       does not mistake it for GPS mouse mode output */
+    if (vld)
+      return n;
+  }
+
+  sp->rcerrno = RCERROR_NORSP;
+  sp->rcerrln = __LINE__;
+  return -1;
+}
+
+
+/*****************************************************************************
+ Write the memory erase command to session sp.
+ *****************************************************************************/
+int set_memory_erase(rtk_session_t *sp) {
   char rsp[64] = "";
   char *lp = NULL;
 
-  lp = get_cmd_response(fd, "$PROY109,-1*", "$LOG109", rsp, 64);
+  lp = cmd_response(sp, "$PROY109,-1*", "$LOG109", rsp, 64, CMD_MNTMT);
   if (lp == NULL)
     return -1;
 
   if (strcmp(lp, "$LOG109,1*61\r\n") != 0) {
-    rcerrno = RCERROR_UNXPRSP;
-    rcerrln = __LINE__;
+    sp->rcerrno = RCERROR_UNXPRSP;
+    sp->rcerrln = __LINE__;
     return -1;
   }
 
@@ -1010,5 +2060,12 @@ void disp_fix(short int ftyp, gps_fix_t gfx) {
   if (ftyp > 1) {
     printf("  Vel: %f", gfx.vel);
   }
+  if (ftyp > 2) {
+    printf("  Dist: %u", (unsigned int)gfx.dist);
+  }
+  if (ftyp > 3) {
+    printf("  Sats: %d  HDOP: %.2f  Course: %f", gfx.nfix >> 4,
+	   gfx.hdop/100.0, gfx.angle);
+  }
   printf("\n");
 }
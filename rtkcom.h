@@ -11,7 +11,7 @@
     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
     General Public License for more details.
 
-    Most recent modification: 20 February 2010
+    Most recent modification: 17 October 2026
 
 ******************************************************************************/
 
@@ -75,21 +75,81 @@ typedef struct {
   float lng;
   float alt;
   float vel;
+  uint32_t dist;     /* distance travelled */
+  float angle;       /* course */
+  uint16_t hdop;     /* dilution of precision, in hundredths */
+  uint16_t pdop;
+  uint16_t vdop;
+  uint8_t unk1;
+  uint8_t nfix;      /* number of satellites used, in the upper 4 bits */
+  uint8_t sat[24];   /* number and signal strength of each satellite */
 } gps_fix_t;
 
-typedef enum {
-  RCERROR_SYS = 1, RCERROR_PARSE, RCERROR_CHECKSUM, RCERROR_NORSP,
-  RCERROR_UNXPRSP, RCERROR_INVLDCMD, RCERROR_MEMALLOC, RCERROR_NULL
-} rcerror_t;
+/* Number of log record types. Types 0 to 2 record time and location,
+   with altitude and velocity added in turn, type 3 adds distance
+   travelled, and type 4 adds satellite status and course. */
+#define NFXTYP 5
 
+/* Maximum number of outstanding log data requests */
+#define XFER_MXWIN 16
 
-extern void (*gdpfp)(unsigned short, unsigned short);
+/* Log data transfer state, which persists across log files, so that
+   the request size only needs to be determined once per connection */
+typedef struct {
+  int nwin;        /* maximum number of outstanding requests */
+  int sctrsz;      /* logger memory sector size, or 0 if unknown */
+  int rqmx;        /* largest request size (bytes) not known to fail */
+  int rqsz;        /* current request size (bytes) */
+  int rqok;        /* largest request size (bytes) accepted */
+  int nacc;        /* requests accepted since the size last changed */
+  int nfail;       /* consecutive failed requests */
+  int nrtry;       /* requests repeated after a failure */
+  int ndup;        /* duplicate sentences discarded */
+} xfer_t;
 
-extern rcerror_t rcerrno;
-extern int rcerrln;
-extern void (*gcwrnfp)(const char *, int, const char *);
+typedef enum {
+  RCERROR_SYS = 1, RCERROR_PARSE, RCERROR_CHECKSUM, RCERROR_NORSP,
+  RCERROR_UNXPRSP, RCERROR_INVLDCMD, RCERROR_MEMALLOC, RCERROR_SEQUENCE,
+  RCERROR_NULL
+} rcerror_t;
 
-const char *gcstrerror(rcerror_t rcerr);
+/* Smoothed estimate of a response time */
+typedef struct {
+  long int srtt;       /* smoothed response time (us), or 0 if unknown */
+  long int rttvar;     /* response time variation (us) */
+} rtt_est_t;
+
+/* Logger protocol session, which holds the connection to a logger and
+   all protocol state, so that several loggers can be used at once,
+   e.g. each from its own thread. The callbacks, if not NULL, report
+   data retrieval progress, pass received fixes and raw records on in
+   order, and pass on warnings, and arg is available to them for their
+   own state. */
+typedef struct rtk_session_s rtk_session_t;
+struct rtk_session_s {
+  transport_t *tp;     /* connection to logger, or NULL if none */
+  rcerror_t rcerrno;   /* number of the last error */
+  int rcerrln;         /* source line at which the last error occurred */
+  rtt_est_t cmdrt;     /* time from a command to its response */
+  rtt_est_t gaprt;     /* time between sentences of a log data response */
+  void (*gdpfp)(rtk_session_t *, int, int);
+  void (*gdcfp)(rtk_session_t *, const gps_fix_t *, int, int);
+  void (*gdrfp)(rtk_session_t *, const char *, long int);
+  void (*gcwrnfp)(rtk_session_t *, const char *, int, const char *);
+  void *arg;           /* callback data */
+  char snt[256];       /* sentence returned by get_sentence */
+  char errstr[512];    /* message returned by gcstrerror when debugging */
+};
+
+/* Decoder of nrec consecutive log data records, of a single record
+   type, at rec into gfxp */
+typedef void (*fix_decoder_t)(rtk_session_t *sp, const char *rec, int nrec,
+			      gps_fix_t *gfxp);
+
+
+rtk_session_t *rtk_session_open(transport_t *tp);
+int rtk_session_close(rtk_session_t *sp);
+const char *gcstrerror(rtk_session_t *sp);
 
 unsigned short fix_size(unsigned short fxtyp);
 const char *fxtyp_string(unsigned short fxtyp);
@@ -103,26 +163,52 @@ uint8_t string_checksum(const char *str);
 int verify_array_checksum(const char *buf, int bsz);
 int verify_string_checksum(const char *str);
 
-int send_cmd(int fd, const char* buf);
-char *get_cmd_response(int fd, const char *cmd, const char *pfx, 
-		       char *rsp, int rsz);
-char *get_sentence(int fd, long int tmt);
-
-int get_status(int fd, status_t *status);
-int get_current_utc(int fd, date_time_t *dtp);
-int get_log_bndry(int fd, log_bndry_t *lgbp);
-int get_memory_info(int fd, memory_t *memp);
-int get_firmware_info(int fd, firmware_t *frmp);
-int get_file_info(int fd, short int filen, logfile_t *lgfp);
-int get_file_start_time(int fd, const logfile_t *lgfp, date_time_t *dtp);
+void rtt_sample(rtt_est_t *rtp, const struct timespec *t0);
+long int rtt_margin(const rtt_est_t *rtp, long int tmt);
+long int rtt_timeout(const rtt_est_t *rtp, long int tmt);
 
-int get_data(int fd, int memp, short int fxtyp, int nfix, 
+int send_cmd(rtk_session_t *sp, const char* buf);
+char *get_response(rtk_session_t *sp, const char *pfx, char *rsp, int rsz,
+		   long int tmt);
+char *get_cmd_response(rtk_session_t *sp, const char *cmd, const char *pfx, 
+		       char *rsp, int rsz);
+char *get_sentence(rtk_session_t *sp, long int tmt);
+int get_sentences(rtk_session_t *sp, const char *pfx,
+		  int (*hndl)(char *, void *), void *arg,
+		  long int tmt, long int tmi);
+
+int get_status(rtk_session_t *sp, status_t *status);
+int get_current_utc(rtk_session_t *sp, date_time_t *dtp);
+int get_log_bndry(rtk_session_t *sp, log_bndry_t *lgbp);
+int get_memory_info(rtk_session_t *sp, memory_t *memp);
+int get_firmware_info(rtk_session_t *sp, firmware_t *frmp);
+int get_file_info(rtk_session_t *sp, short int filen, logfile_t *lgfp);
+int get_files_info(rtk_session_t *sp, short int fn0, short int nfile,
+		   int nwin, void (*hndl)(short int, const logfile_t *, void *),
+		   void *arg);
+int get_file_start_time(rtk_session_t *sp, const logfile_t *lgfp,
+			date_time_t *dtp);
+
+fix_decoder_t fix_decoder(unsigned short fxtyp);
+void fix_decode(rtk_session_t *sp, const char *rec, short int fxtyp,
+		int nrec, gps_fix_t *gfxp);
+int get_data(rtk_session_t *sp, int memp, short int fxtyp, int nfix, 
 	     gps_fix_t *gfxp, int nfxt, int nfxb);
-int get_file_data(int fd, const logfile_t *lgfp, gps_fix_t *gfxp);
-
-int set_mode(int fd, short int log, short int out);
-int set_status(int fd, const status_t *status);
-int set_memory_erase(int fd);
+void xfer_init(xfer_t *xfp, int nwin, unsigned int sctrsz);
+int get_file_data(rtk_session_t *sp, const logfile_t *lgfp,
+		  gps_fix_t *gfxp, int fn0, xfer_t *xfp);
+int files_contiguous(const logfile_t *lgflp, int nfile);
+int get_files_data(rtk_session_t *sp, const logfile_t *lgflp, int nfile,
+		   gps_fix_t *gfxp, xfer_t *xfp);
+int get_files_raw(rtk_session_t *sp, const logfile_t *lgflp, int nfile,
+		  xfer_t *xfp);
+
+int set_mode(rtk_session_t *sp, short int log, short int out);
+int set_status(rtk_session_t *sp, const status_t *status);
+int set_memory_erase(rtk_session_t *sp);
+int set_line_speed(rtk_session_t *sp, unsigned int speed);
+int detect_line_speed(rtk_session_t *sp, const unsigned int *spdl, int nspd,
+		      long int tmt);
 
 void print_bytes(FILE *stream, const char *buf, int bsz);
 void disp_fix(short int ftyp, gps_fix_t gfx);
@@ -0,0 +1,524 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+/* Emulator for Royaltek GPS loggers, serving synthetic log data over a
+   pseudo-terminal, for testing and benchmarking rtkgps without a
+   logger attached. */
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <getopt.h>
+#include <errno.h>
+#include "serial.h"
+#include "rtkcom.h"
+
+/* Maximum number of log files and commands awaiting a response */
+#define EMU_MXFILE 64
+#define EMU_MXCMD 32
+/* Maximum number of data bytes in a single $LOG102 sentence */
+#define EMU_MXLOGB 240
+/* Maximum number of data bytes in response to a single $PROY102 request */
+#define EMU_MXREQ 8192
+
+
+typedef struct {
+  int rate;                 /* emulated line speed, 0 if unthrottled */
+  long int ltnc;            /* command response latency in ms */
+  short int vflg;           /* verbose mode */
+  short int fxtyp;          /* current log record type */
+  short int mfowm;          /* memory full behaviour */
+  short int sntvl;          /* sampling interval */
+  short int gpsms;          /* GPS mouse mode */
+  short int nfile;          /* number of log files */
+  logfile_t lgfl[EMU_MXFILE]; /* log file metadata */
+  unsigned char *mem;       /* fix memory */
+  size_t msz;               /* number of bytes of fix memory in use */
+  char *obuf;               /* output queue */
+  size_t obsz, obrp, obwp;  /* output queue size and positions */
+  struct timespec txtm;     /* time at which output line becomes idle */
+  struct {
+    struct timespec due;
+    char cmd[64];
+  } cmdq[EMU_MXCMD];        /* commands awaiting a response */
+  int cqn;                  /* number of queued commands */
+} emulator_t;
+
+
+void emu_fixmem(emulator_t *emp, short int nfile, int nfix, short int fxtyp);
+unsigned char *emu_store(unsigned char *mp, uint32_t w, int nb);
+void emu_send(emulator_t *emp, const char *buf, size_t bsz);
+void emu_reply(emulator_t *emp, const char *fmt, ...);
+void emu_command(emulator_t *emp, const char *cmd);
+void emu_mouse(emulator_t *emp);
+void emu_log_data(emulator_t *emp, int memp, short int fxtyp, int nfix);
+long int emu_flush(emulator_t *emp, int fd);
+void time_add(struct timespec *tsp, long int us);
+
+
+/*****************************************************************************
+ Main program.
+ *****************************************************************************/
+int main(int argc, char *argv[]) {
+  const char *usage =
+   "usage: rtkemu [-h] [-v] [-m] [-n <nfile>] [-f <nfix>] [-t <fxtyp>]\n"
+   "              [-r <rate>] [-l <ms>]\n\n"
+   "       -h         display usage\n"
+   "       -v         verbose mode\n"
+   "       -m         start in GPS mouse mode\n"
+   "       -n <nfile> number of log files (default 3)\n"
+   "       -f <nfix>  number of fixes in each log file (default 500)\n"
+   "       -t <fxtyp> record type for all files (0 to 4), rather than\n"
+   "                  cycling through the record types\n"
+   "       -r <rate>  emulate line speed of rate baud (default unthrottled),\n"
+   "                  which may be changed by the SiRF $PSRF100 command\n"
+   "       -l <ms>    delay before responding to each command\n";
+  static emulator_t emu;
+  struct termios tio;
+  struct pollfd pfd;
+  struct timespec tick;
+  char ibuf[1024];
+  size_t ibn = 0;
+  char *bp, *ep;
+  long int tmt, t;
+  ssize_t b;
+  int mfd, sfd, n, nfix = 500;
+  short int nfile = 3, fxtyp = -1;
+
+  memset(&emu, 0, sizeof(emu));
+  emu.sntvl = 1;
+  while ((n = getopt(argc, argv, "hvmn:f:t:r:l:")) != -1)
+    switch (n) {
+    case 'h': fprintf(stderr, "%s", usage);
+      exit(0);
+    case 'v': emu.vflg = 1;
+      break;
+    case 'm': emu.gpsms = 1;
+      break;
+    case 'n': nfile = atoi(optarg);
+      break;
+    case 'f': nfix = atoi(optarg);
+      break;
+    case 't': fxtyp = atoi(optarg);
+      break;
+    case 'r': emu.rate = atoi(optarg);
+      break;
+    case 'l': emu.ltnc = atol(optarg);
+      break;
+    default: fprintf(stderr, "%s", usage);
+      exit(1);
+    }
+  if (nfile < 0 || nfile > EMU_MXFILE || nfix < 1 || fxtyp >= NFXTYP ||
+      emu.rate < 0 || emu.ltnc < 0) {
+    fprintf(stderr, "%s", usage);
+    exit(1);
+  }
+  emu_fixmem(&emu, nfile, nfix, fxtyp);
+
+  /* Open the pseudo-terminal master, and hold the slave open so that
+     the master remains usable while no client is connected */
+  if ((mfd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(mfd) < 0 ||
+      unlockpt(mfd) < 0 ||
+      (sfd = open(ptsname(mfd), O_RDWR | O_NOCTTY)) < 0) {
+    fprintf(stderr, "rtkemu: Error opening pseudo-terminal [%s]\n",
+	    strerror(errno));
+    exit(4);
+  }
+  if (tcgetattr(sfd, &tio) == 0) {
+    cfmakeraw(&tio);
+    tcsetattr(sfd, TCSANOW, &tio);
+  }
+  fcntl(mfd, F_SETFL, fcntl(mfd, F_GETFL, 0) | O_NONBLOCK);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("%s\n", ptsname(mfd));
+  fflush(stdout);
+
+  deadline_set(&tick, 1000);
+  clock_gettime(DEADLINE_CLOCK, &emu.txtm);
+  for (;;) {
+    /* Determine how long to wait for the next event */
+    tmt = deadline_remaining(&tick);
+    if (emu.cqn > 0 && (t = deadline_remaining(&emu.cmdq[0].due)) < tmt)
+      tmt = t;
+    /* Output waiting for the master to become writable is handled by
+       poll rather than by the timeout */
+    if ((t = emu_flush(&emu, mfd)) > 0 && t < tmt)
+      tmt = t;
+
+    pfd.fd = mfd;
+    pfd.events = POLLIN | ((t == 0)?POLLOUT:0);
+    if (poll(&pfd, 1, tmt) < 0 && errno != EINTR) {
+      fprintf(stderr, "rtkemu: Error waiting for input [%s]\n",
+	      strerror(errno));
+      exit(5);
+    }
+
+    /* Read and queue commands */
+    if ((b = read(mfd, ibuf + ibn, sizeof(ibuf) - ibn - 1)) > 0) {
+      ibn += b;
+      ibuf[ibn] = '\0';
+      while ((bp = strstr(ibuf, "$P")) != NULL &&
+	     (ep = strstr(bp, "\r\n")) != NULL) {
+	*ep = '\0';
+	if (emu.cqn < EMU_MXCMD) {
+	  deadline_set(&emu.cmdq[emu.cqn].due, emu.ltnc);
+	  strncpy(emu.cmdq[emu.cqn].cmd, bp, 63);
+	  emu.cmdq[emu.cqn].cmd[63] = '\0';
+	  emu.cqn++;
+	}
+	ibn -= ep + 2 - ibuf;
+	memmove(ibuf, ep + 2, ibn + 1);
+      }
+      /* Discard input that can not be part of a command */
+      if (ibn == sizeof(ibuf) - 1 || (ibn > 0 && strchr(ibuf, '$') == NULL))
+	ibn = 0;
+    }
+
+    /* Respond to commands for which the latency has expired */
+    while (emu.cqn > 0 && deadline_remaining(&emu.cmdq[0].due) == 0) {
+      emu_command(&emu, emu.cmdq[0].cmd);
+      emu.cqn--;
+      memmove(emu.cmdq, emu.cmdq + 1, emu.cqn*sizeof(emu.cmdq[0]));
+    }
+
+    /* Emit GPS mouse mode output at 1Hz */
+    if (deadline_remaining(&tick) == 0) {
+      if (emu.gpsms)
+	emu_mouse(&emu);
+      time_add(&tick, 1000000L);
+    }
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Generate nfile synthetic log files of nfix fixes each. If fxtyp is
+ negative, the record type cycles through all valid values.
+ *****************************************************************************/
+void emu_fixmem(emulator_t *emp, short int nfile, int nfix, short int fxtyp) {
+  unsigned char *mp;
+  float fv[4], crs = 90.0f;
+  uint32_t w;
+  int f, n, k, s, fxtp, nsat;
+
+  emp->nfile = nfile;
+  emp->msz = 0;
+  for (f = 0; f < nfile; f++) {
+    emp->lgfl[f].fxtyp = (fxtyp < 0)?(f % NFXTYP):fxtyp;
+    emp->lgfl[f].nfix = nfix;
+    emp->lgfl[f].memp = emp->msz;
+    sprintf(emp->lgfl[f].date, "2026%02d%02d", 1 + (f / 28) % 12,
+	    1 + f % 28);
+    emp->msz += nfix*fix_size(emp->lgfl[f].fxtyp);
+  }
+  emp->fxtyp = (nfile > 0)?emp->lgfl[nfile-1].fxtyp:2;
+  if ((emp->mem = malloc(emp->msz + 1)) == NULL) {
+    fprintf(stderr, "rtkemu: Error allocating memory\n");
+    exit(2);
+  }
+
+  /* Fixes follow a slow track, with values stored little-endian as
+     in logger memory */
+  mp = emp->mem;
+  for (f = 0; f < nfile; f++) {
+    fxtp = emp->lgfl[f].fxtyp;
+    for (n = 0; n < nfix; n++) {
+      s = 8*3600 + f*600 + n*emp->sntvl;
+      *mp++ = 0;
+      *mp++ = (s / 3600) % 24;
+      *mp++ = (s / 60) % 60;
+      *mp++ = s % 60;
+      fv[0] = 0.7f + 1e-3f*f + 1e-6f*n;
+      fv[1] = 0.1f + 1e-6f*n;
+      fv[2] = 100.0f + 0.1f*n;
+      fv[3] = 5.0f;
+      for (k = 0; k < 2 + fxtp && k < 4; k++) {
+	memcpy(&w, fv + k, sizeof(w));
+	mp = emu_store(mp, w, 4);
+      }
+      if (fxtp > 2)
+	mp = emu_store(mp, 15*n, 4);
+      /* Record type 4 adds satellite status and course */
+      if (fxtp > 3) {
+	nsat = 4 + n % 9;
+	*mp++ = 0;
+	*mp++ = nsat << 4;
+	mp = emu_store(mp, 90 + n % 40, 2);
+	mp = emu_store(mp, 160 + n % 40, 2);
+	mp = emu_store(mp, 130 + n % 40, 2);
+	for (k = 0; k < 12; k++) {
+	  *mp++ = (k < nsat)?3 + 2*k:0;
+	  *mp++ = (k < nsat)?30 + k:0;
+	}
+	memcpy(&w, &crs, sizeof(w));
+	mp = emu_store(mp, w, 4);
+      }
+    }
+  }
+}
+
+
+/*****************************************************************************
+ Store the nb least significant bytes of w at mp in little-endian
+ order, returning the position following them.
+ *****************************************************************************/
+unsigned char *emu_store(unsigned char *mp, uint32_t w, int nb) {
+  int j;
+
+  for (j = 0; j < nb; j++)
+    *mp++ = (w >> 8*j) & 0xff;
+  return mp;
+}
+
+
+/*****************************************************************************
+ Append bsz bytes in buf to the output queue.
+ *****************************************************************************/
+void emu_send(emulator_t *emp, const char *buf, size_t bsz) {
+  if (emp->obrp > 0) {
+    memmove(emp->obuf, emp->obuf + emp->obrp, emp->obwp - emp->obrp);
+    emp->obwp -= emp->obrp;
+    emp->obrp = 0;
+  }
+  if (emp->obwp + bsz > emp->obsz) {
+    emp->obsz = 2*(emp->obwp + bsz);
+    if ((emp->obuf = realloc(emp->obuf, emp->obsz)) == NULL) {
+      fprintf(stderr, "rtkemu: Error allocating memory\n");
+      exit(2);
+    }
+  }
+  memcpy(emp->obuf + emp->obwp, buf, bsz);
+  emp->obwp += bsz;
+}
+
+
+/*****************************************************************************
+ Queue the sentence with body specified by format string fmt, adding
+ the leading '$' and the trailing checksum.
+ *****************************************************************************/
+void emu_reply(emulator_t *emp, const char *fmt, ...) {
+  char body[256], snt[264];
+  va_list ap;
+  int bln;
+
+  va_start(ap, fmt);
+  bln = vsnprintf(body, sizeof(body), fmt, ap);
+  va_end(ap);
+  if (bln >= (int)sizeof(body))
+    bln = sizeof(body) - 1;
+
+  sprintf(snt, "$%s*%02X\r\n", body, array_checksum(body, bln));
+  emu_send(emp, snt, bln + 6);
+  if (emp->vflg)
+    fprintf(stderr, "<<< %s", snt);
+}
+
+
+/*****************************************************************************
+ Respond to command cmd.
+ *****************************************************************************/
+void emu_command(emulator_t *emp, const char *cmd) {
+  const char *cp;
+  time_t t;
+  struct tm *tmp;
+  int n, a0, a1, a2, a3;
+
+  if (emp->vflg)
+    fprintf(stderr, ">>> %s\n", cmd);
+
+  /* Ignore commands with an incorrect checksum. SiRF commands use the
+     standard NMEA checksum, while for PROY commands it is computed,
+     as by rtkgps, over the whole command including the leading '$'
+     and the trailing '*'. */
+  if ((cp = strchr(cmd, '*')) == NULL)
+    return;
+  if (strncmp(cmd, "$PSRF", 5) == 0) {
+    if (strtol(cp + 1, NULL, 16) != array_checksum(cmd + 1, cp - cmd - 1))
+      return;
+  } else if (strtol(cp + 1, NULL, 16) != array_checksum(cmd, cp + 1 - cmd))
+    return;
+
+  if (strncmp(cmd, "$PROY003*", 9) == 0) {
+    t = time(NULL);
+    tmp = gmtime(&t);
+    emu_reply(emp, "LOG003,%04d%02d%02d,%02d%02d%02d", tmp->tm_year+1900,
+	      tmp->tm_mon+1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min,
+	      tmp->tm_sec);
+  } else if (strncmp(cmd, "$PROY005*", 9) == 0) {
+    emu_reply(emp, "PSRFTXT,VersionR: RTKEMU-%s", PACKAGE_VERSION);
+    emu_reply(emp, "PSRFTXT,[ONOFFLOG]RoyalTek Ver 1.4.0.211 GSW3LP");
+    emu_reply(emp, "PSRFTXT,Baud rate: %d", (emp->rate > 0)?emp->rate:57600);
+    emu_reply(emp, "PSRFTXT,Driver Revision = 1.0");
+    emu_reply(emp, "PSRFTXT,Emulated logger");
+  } else if (strncmp(cmd, "$PROY006*", 9) == 0) {
+    if (emp->nfile > 0) {
+      /* Time of the last fix, as generated by emu_fixmem */
+      n = 8*3600 + (emp->nfile-1)*600 +
+	(emp->lgfl[emp->nfile-1].nfix-1)*emp->sntvl;
+      emu_reply(emp, "LOG006,%s,080000,%s,%02d%02d%02d",
+		emp->lgfl[0].date, emp->lgfl[emp->nfile-1].date,
+		(n / 3600) % 24, (n / 60) % 60, n % 60);
+    } else
+      emu_reply(emp, "LOG006,00000000,000000,00000000,000000");
+  } else if (strncmp(cmd, "$PROY100*", 9) == 0) {
+    emu_reply(emp, "LOG100,%d,%d,%d", 4194304, 65536, 64);
+  } else if (sscanf(cmd, "$PROY101,%d*", &a0) == 1) {
+    if (a0 >= 0 && a0 < emp->nfile)
+      emu_reply(emp, "LOG101,%s,%hd,%d,%d", emp->lgfl[a0].date,
+		emp->lgfl[a0].fxtyp, emp->lgfl[a0].nfix, emp->lgfl[a0].memp);
+    else
+      emu_reply(emp, "LOG101,0");
+  } else if (sscanf(cmd, "$PROY102,%d,%d,%d*", &a0, &a1, &a2) == 3) {
+    emu_log_data(emp, a0, a1, a2);
+  } else if (sscanf(cmd, "$PROY103,%d,%d*", &a0, &a1) == 2) {
+    emp->gpsms = a1;
+    emu_reply(emp, "LOG103,1");
+  } else if (sscanf(cmd, "$PROY104,%d,%d,%d,%d*", &a0, &a1, &a2, &a3) == 4) {
+    emp->sntvl = a1;
+    emp->fxtyp = a2;
+    emp->mfowm = a3;
+    emu_reply(emp, "LOG104,1");
+  } else if (strncmp(cmd, "$PROY108*", 9) == 0) {
+    n = (emp->nfile > 0)?emp->lgfl[emp->nfile-1].nfix:0;
+    emu_reply(emp, "LOG108,%hd,0,0,%hd,0,%hd,192,%hd,%d", emp->fxtyp,
+	      emp->mfowm, emp->sntvl, emp->nfile, n);
+  } else if (sscanf(cmd, "$PSRF100,1,%d,8,1,0*", &a0) == 1) {
+    /* There is no response to a line speed change. The new speed
+       only affects emulated output speed if throttling is enabled. */
+    if (emp->rate > 0 && a0 > 0)
+      emp->rate = a0;
+  } else if (strncmp(cmd, "$PROY109,", 9) == 0) {
+    emp->nfile = 0;
+    emp->msz = 0;
+    emu_reply(emp, "LOG109,1");
+  }
+}
+
+
+/*****************************************************************************
+ Queue $LOG102 sentences containing nfix fixes of record type fxtyp
+ from memory address memp.
+ *****************************************************************************/
+void emu_log_data(emulator_t *emp, int memp, short int fxtyp, int nfix) {
+  char snt[EMU_MXLOGB + 20];
+  int fsz, nbyt, rbc, sn, idx = 0;
+
+  fsz = fix_size(fxtyp);
+  if (fsz == 0 || memp < 0 || nfix < 1 || memp + nfix*fsz > (int)emp->msz || nfix*fsz > EMU_MXREQ) {
+    emu_reply(emp, "LOG102,0");
+    return;
+  }
+
+  nbyt = nfix*fsz;
+  while (nbyt > 0) {
+    /* Each sentence holds a whole number of fixes */
+    rbc = (EMU_MXLOGB / fsz)*fsz;
+    if (rbc > nbyt)
+      rbc = nbyt;
+    sn = sprintf(snt, "$LOG102,");
+    snt[sn++] = idx++;
+    snt[sn++] = ',';
+    snt[sn++] = rbc;
+    memcpy(snt + sn, emp->mem + memp, rbc);
+    sn += rbc;
+    sn += sprintf(snt + sn, "*%02X\r\n", array_checksum(snt + 1, sn - 1));
+    emu_send(emp, snt, sn);
+    memp += rbc;
+    nbyt -= rbc;
+  }
+  if (emp->vflg)
+    fprintf(stderr, "<<< %d $LOG102 sentences\n", idx);
+}
+
+
+/*****************************************************************************
+ Queue GPS mouse mode output: position, fix, and status sentences.
+ *****************************************************************************/
+void emu_mouse(emulator_t *emp) {
+  time_t t;
+  struct tm *tmp;
+  int n;
+
+  t = time(NULL);
+  tmp = gmtime(&t);
+  emu_reply(emp, "GPRMC,%02d%02d%02d.000,A,4007.0380,N,01131.0000,E,"
+	    "0.00,0.00,%02d%02d%02d,,,A", tmp->tm_hour, tmp->tm_min,
+	    tmp->tm_sec, tmp->tm_mday, tmp->tm_mon+1, tmp->tm_year%100);
+  emu_reply(emp, "GPGGA,%02d%02d%02d.000,4007.0380,N,01131.0000,E,1,06,"
+	    "1.2,100.0,M,47.0,M,,0000", tmp->tm_hour, tmp->tm_min,
+	    tmp->tm_sec);
+  n = (emp->nfile > 0)?emp->lgfl[emp->nfile-1].nfix:0;
+  emu_reply(emp, "LOG108,%hd,0,0,%hd,0,%hd,192,%hd,%d", emp->fxtyp,
+	    emp->mfowm, emp->sntvl, emp->nfile, n);
+}
+
+
+/*****************************************************************************
+ Write queued output to fd, at no more than the emulated line
+ speed. Returns the number of ms until more output can be written, 0
+ if output is waiting for fd to become writable, or -1 if the queue
+ is empty.
+ *****************************************************************************/
+long int emu_flush(emulator_t *emp, int fd) {
+  struct timespec now;
+  size_t n;
+  ssize_t b;
+  long int t;
+
+  while (emp->obwp > emp->obrp) {
+    if (emp->rate > 0 && (t = deadline_remaining(&emp->txtm)) > 0)
+      return t;
+
+    /* When throttled, write roughly 10ms of output at a time */
+    n = emp->obwp - emp->obrp;
+    if (emp->rate > 0 && n > (size_t)emp->rate/1000 + 1)
+      n = emp->rate/1000 + 1;
+    if ((b = write(fd, emp->obuf + emp->obrp, n)) <= 0)
+      return 0;
+    emp->obrp += b;
+
+    if (emp->rate > 0) {
+      /* Each byte occupies 10 bits on the line */
+      clock_gettime(DEADLINE_CLOCK, &now);
+      if (deadline_remaining(&emp->txtm) == 0)
+	emp->txtm = now;
+      time_add(&emp->txtm, (10000000L*b)/emp->rate);
+    }
+  }
+
+  return -1;
+}
+
+
+/*****************************************************************************
+ Add us microseconds to time tsp.
+ *****************************************************************************/
+void time_add(struct timespec *tsp, long int us) {
+  tsp->tv_sec += us / 1000000L;
+  tsp->tv_nsec += (us % 1000000L) * 1000L;
+  if (tsp->tv_nsec >= 1000000000L) {
+    tsp->tv_sec++;
+    tsp->tv_nsec -= 1000000000L;
+  }
+}
@@ -11,7 +11,7 @@
     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
     General Public License for more details.
 
-    Most recent modification: 4 February 2012
+    Most recent modification: 17 October 2026
 
 ******************************************************************************/
 
@@ -28,7 +28,13 @@
 #include <errno.h>
 #include <assert.h>
 #include "serial.h"
+#include "trace.h"
+#include "fault.h"
+#include "cache.h"
 #include "rtkcom.h"
+#include "ckpt.h"
+#include "logcache.h"
+#include "dump.h"
 #include "gpsfmt.h"
 
 
@@ -49,15 +55,54 @@ typedef struct {
   char *dsts;
   char *flns;
   char *cmds;
+  char *caps; /* capture trace file */
+  char *flts; /* fault injection profile */
+  char *imgs; /* raw memory image file */
+  char *xspds;
+  char *wins;
   short int sint;
   short int fnmn;
   short int fnmx;
   unsigned int sspd; /* serial line speed */
-  char usgs[1500];
+  unsigned int xspd; /* line speed for log data transfer */
+  int dwin; /* number of outstanding data requests */
+  char usgs[3000];
 } cmdlnopts_t;
 
+/* Total memory used by log files, accumulated as their metadata is
+   received */
+typedef struct {
+  const logcache_t *lcp;
+  unsigned int mu;
+} file_size_sum_t;
+
+/* Table of log file metadata, filled in as the metadata is received,
+   and of log file start times, where known */
+typedef struct {
+  const logcache_t *lcp;
+  logfile_t *lgflp;
+  char (*timep)[7]; /* start times, empty if not known, or NULL */
+} file_table_t;
+
+/* Log files being retrieved by a single sweep of logger memory, each
+   of which is checkpointed in turn as its fixes are received */
+typedef struct {
+  const logfile_t *lgflp; /* metadata of the log files */
+  char (*timep)[7];       /* start time of each log file */
+  gps_fix_t *gfxp;        /* fixes of all of the log files */
+  short int flnm;         /* number of the first log file */
+  short int cur;          /* index of the log file being received */
+  int fxb;                /* index of its first fix in gfxp */
+  char *fnam;             /* buffer for constructing file names */
+  const logcache_t *lcp;
+  const cmdlnopts_t *cmdopt;
+} sweep_t;
+
 
 int prgbrfp = 0;
+unsigned int xfrspd = 0; /* line speed, if switched for data transfer */
+checkpoint_t ckpt = {NULL, "", 0, 0, 0}; /* checkpoint of log file being read */
+sweep_t swp = {NULL, NULL, NULL, 0, 0, 0, NULL, NULL, NULL}; /* sweep state */
 
 void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt);
 void cmd_status(cmdlnopts_t *cmdopt);
@@ -66,22 +111,69 @@ void cmd_list(cmdlnopts_t *cmdopt);
 void cmd_set(cmdlnopts_t *cmdopt);
 void cmd_read(cmdlnopts_t *cmdopt);
 void cmd_erase(cmdlnopts_t *cmdopt);
-
-void get_data_progress(unsigned short nfxt, unsigned short nfxc);
+void cmd_dump(cmdlnopts_t *cmdopt);
+void cmd_split(cmdlnopts_t *cmdopt);
+
+void get_data_progress(rtk_session_t *sp, int nfxt, int nfxc);
+void get_data_checkpoint(rtk_session_t *sp, const gps_fix_t *gfxp, int fn0,
+			 int nfx);
+void sweep_checkpoint(rtk_session_t *sp, const gps_fix_t *gfxp, int fn0,
+		      int nfx);
+void get_data_raw(rtk_session_t *sp, const char *rec, long int nbyt);
+void file_info_print(short int filen, const logfile_t *lgfp, void *arg);
+void file_info_size(short int filen, const logfile_t *lgfp, void *arg);
+void file_info_store(short int filen, const logfile_t *lgfp, void *arg);
+void metadata_cache_open(rtk_session_t *sp, logcache_t *lcp,
+			 const log_bndry_t *lgbp, const status_t *status,
+			 const cmdlnopts_t *cmdopt);
+int file_info(rtk_session_t *sp, const logcache_t *lcp, short int filen,
+	      logfile_t *lgfp);
+int file_table(rtk_session_t *sp, file_table_t *ftp, short int fn0,
+	       short int fn1, const cmdlnopts_t *cmdopt);
+int memory_info(rtk_session_t *sp, const logcache_t *lcp, memory_t *memp);
+void progress_bar_enable(rtk_session_t *sp);
 void text_progress_bar(float frac, const char *prfs);
-void warning(const char *wrn, int line, const char *file);
+void warning(rtk_session_t *sp, const char *wrn, int line, const char *file);
 int is_directory(const char *path);
 int file_backup(const char *path);
-int coms_open(cmdlnopts_t *cmdopt);
-void coms_close(int fd, const cmdlnopts_t *cmdopt);
-void gpsmouse_disable(int fd, int md, const cmdlnopts_t *cmdopt);
-void gpsmouse_enable(int fd, int md, const cmdlnopts_t *cmdopt);
-void outlog_disable(int fd, const cmdlnopts_t *cmdopt);
-void outlog_enable(int fd, int md, const cmdlnopts_t *cmdopt);
-void status_read(int fd, status_t *status, const cmdlnopts_t *cmdopt);
-void file_read(int fd, short int flnm, char *fnam, FILE *strm,
-	       const geoid_height_t *gdhtp, const status_t* status,
+int file_range(cmdlnopts_t *cmdopt, short int nfile);
+int output_open(const cmdlnopts_t *cmdopt, FILE **strmp, char **fnamp);
+void output_file_name(char *fnam, const logfile_t *lgfp, const char *time,
+		      int part, const cmdlnopts_t *cmdopt);
+rtk_session_t *coms_open(cmdlnopts_t *cmdopt);
+void line_speed_detect(rtk_session_t *sp, cmdlnopts_t *cmdopt);
+#if ENABLE_LINUX_BT-0
+void bt_scan_select(char *btas, const cmdlnopts_t *cmdopt);
+transport_t *bt_connect(const char *btas, int ntry);
+#endif /* ENABLE_LINUX_BT */
+void coms_close(rtk_session_t *sp, const cmdlnopts_t *cmdopt);
+void gpsmouse_disable(rtk_session_t *sp, int md, const cmdlnopts_t *cmdopt);
+void gpsmouse_enable(rtk_session_t *sp, int md, const cmdlnopts_t *cmdopt);
+void outlog_disable(rtk_session_t *sp, const cmdlnopts_t *cmdopt);
+void outlog_enable(rtk_session_t *sp, int md, const cmdlnopts_t *cmdopt);
+void xfer_speed_enable(rtk_session_t *sp, const cmdlnopts_t *cmdopt);
+void xfer_speed_restore(rtk_session_t *sp, const cmdlnopts_t *cmdopt);
+void xfer_report(const xfer_t *xfp, const cmdlnopts_t *cmdopt);
+void status_read(rtk_session_t *sp, status_t *status,
+		 const cmdlnopts_t *cmdopt);
+void file_read(rtk_session_t *sp, short int flnm, const file_table_t *ftp,
+	       char *fnam, FILE *strm, const geoid_height_t *gdhtp,
+	       const status_t* status, xfer_t *xfp,
 	       const cmdlnopts_t *cmdopt);
+short int sweep_select(rtk_session_t *sp, const file_table_t *ftp,
+		       short int flnm, short int fnmx, char *fnam,
+		       const status_t *status, const cmdlnopts_t *cmdopt);
+void sweep_read(rtk_session_t *sp, const file_table_t *ftp, short int flnm,
+		short int nfile, char *fnam, FILE *strm,
+		const geoid_height_t *gdhtp, const status_t* status,
+		xfer_t *xfp, const cmdlnopts_t *cmdopt);
+void log_write(FILE *strm, const logfile_t *lgfp, const gps_fix_t *gfxp,
+	       const float *gcrp, int hdr, const cmdlnopts_t *cmdopt);
+void file_split(rtk_session_t *sp, const dump_t *dp, short int flnm,
+		char *fnam, FILE *strm, const geoid_height_t *gdhtp,
+		const cmdlnopts_t *cmdopt);
+void geoid_correct(const geoid_height_t *gdhtp, const logfile_t *lgfp,
+		   const gps_fix_t *gfxp, float *gcrp);
 
 
 /*****************************************************************************
@@ -89,35 +181,52 @@ void file_read(int fd, short int flnm, char *fnam, FILE *strm,
  *****************************************************************************/
 int main (int argc, char* argv[]) {
   const char* usage0 =
-   "usage: rtkgps [-h] [-v] [-d <dev> [-r <rate>] | -b <addr>]\n"
-   "              ([-e] status | date | list | [-y] erase |\n"
+   "usage: rtkgps [-h] [-v] [-d <dev> [-r <rate>] | -b <addr>]"
+   " [--capture <file>]\n"
+   "              [--faults <prf>]\n"
+   "              ([-e] status | date | [-w <n>] list | [-y] erase |\n"
    "              [-c <flg>] [-l <lgtp>] [-m <mfo>] [-s <int>] set |\n"
-   "              [-n] [-p] [-o <dest> [-u]] [-f <nstr>] read)\n\n"
+   "              [-n] [-p] [-o <dest> [-u]] [-f <nstr>] [-x <rate>]\n"
+   "              [-w <n>] read |\n"
+   "              [-p] [-o <file>] [-x <rate>] [-w <n>] dump)\n"
+   "       rtkgps [-h] [-v] -i <file> [-n] [-o <dest>] [-f <nstr>] split\n\n"
    "       -h        display usage\n"
    "       -v        verbose mode\n"
-   "       -d <dev>  specify serial device\n"
-   "       -r <rate> specify baud rate for serial device\n"
+   "       -d <dev>  specify serial device, or tcp:<host>:<port>, pty:<path>,\n"
+   "                 file:<path>, replay:<path>, or replay-fast:<path>\n"
+   "                 connection\n"
+   "       -r <rate> specify baud rate for serial device (default: detect,\n"
+   "                 or 57600 if detection fails; not used for other\n"
+   "                 connection types)\n"
    "       -b <addr> specify bluetooth address\n"
-   "       -e        display extended status information\n";
+   "       -e        display extended status information\n"
+   "       -i <file> specify memory image file written by dump command\n";
   const char* usage1 =
    "       -c <flg>  set real-time output (GPS mouse) mode "
                      "(0=disable, 1=enable)\n"
-   "       -l <lgtp> set log record type (tl, tla, or tlav)\n"
+   "       -l <lgtp> set log record type (tl, tla, tlav, tlavd, or tlavds)\n"
    "       -m <mfo>  set memory overwrite behaviour (o=overwrite, s=stop)\n"
    "       -s <int>  set sampling interval in seconds\n"
    "       -n        output data in simple native text form\n"
    "       -p        display text progress bar\n"
    "       -o <dest> specify destination file or directory\n"
-   "       -u        skip downloading date for existing files\n";
+   "       -u        skip downloading date for existing files, and only\n"
+   "                 download new data for the last file\n";
   const char* usage2 =
    "       -f <nstr> string specifying index number(s) of log file(s) \n"
    "                 to retrieve as a single file number, or range of \n"
    "                 file numbers in the format -n, n-, or n-m\n"
-   "       -y        don't ask for confirmation\n";
+   "       -x <rate> switch serial device to rate baud for data transfer\n"
+   "       -w <n>    number of data or file metadata requests to keep\n"
+   "                 outstanding (default 4)\n"
+   "       -y        don't ask for confirmation\n"
+   "       --capture <file> record device traffic to trace file\n"
+   "       --faults <prf> inject input faults, see rtkgps(1)\n";
 
   /* most Royalteks operate on 57600 baud, use that as the default */
   cmdlnopts_t cmdopt = {0,0,0,0,0,0,NULL,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
-			NULL,NULL,-1,-1,-1,57600,""};
+			NULL,NULL,NULL,NULL,NULL,NULL,NULL,-1,-1,-1,57600,0,4,
+			""};
 
   /* Initialise usage string */
   strcpy(cmdopt.usgs, usage0);
@@ -126,9 +235,6 @@ int main (int argc, char* argv[]) {
   /* Scan command line options */
   scan_cmdline(argc, argv, &cmdopt);
 
-  /* Set up warning callback function */
-  gcwrnfp = warning;
-
   /* Perform requested task */
   if (strcmp(cmdopt.cmds,"status") == 0) {
     cmd_status(&cmdopt);
@@ -142,6 +248,10 @@ int main (int argc, char* argv[]) {
     cmd_read(&cmdopt);
   } else if (strcmp(cmdopt.cmds,"erase") == 0) {
     cmd_erase(&cmdopt);
+  } else if (strcmp(cmdopt.cmds,"dump") == 0) {
+    cmd_dump(&cmdopt);
+  } else if (strcmp(cmdopt.cmds,"split") == 0) {
+    cmd_split(&cmdopt);
   }
 
   exit(0);
@@ -152,11 +262,17 @@ int main (int argc, char* argv[]) {
  Scan command line arguments and check for valid choices.
  *****************************************************************************/
 void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
+  static const struct option lopts[] = {
+    {"capture", required_argument, NULL, 'C'},
+    {"faults", required_argument, NULL, 'F'},
+    {NULL, 0, NULL, 0}
+  };
   int n;
 
   /* Scan command line options */
   opterr = 0;
-  while ((n = getopt (argc, argv, "hved:r:b:l:m:c:s:npo:uf:y")) != -1)
+  while ((n = getopt_long(argc, argv, "hvei:d:r:b:l:m:c:s:npo:uf:x:w:y",
+			  lopts, NULL)) != -1)
     switch (n) {
     case 'h': fprintf(stderr, "%s", cmdopt->usgs);
       exit(0);
@@ -167,6 +283,8 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
       break;
     case 'e': cmdopt->eflg = 1;
       break;
+    case 'i': cmdopt->imgs = optarg;
+      break;
     case 'd': cmdopt->devs = optarg;
       break;
     case 'r': cmdopt->spds = optarg;
@@ -191,8 +309,16 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
       break;
     case 'f': cmdopt->flns = optarg;
       break;
+    case 'x': cmdopt->xspds = optarg;
+      break;
+    case 'w': cmdopt->wins = optarg;
+      break;
     case 'y': cmdopt->yflg = 1;
       break;
+    case 'C': cmdopt->caps = optarg;
+      break;
+    case 'F': cmdopt->flts = optarg;
+      break;
     default:
       exit(1);
     }
@@ -202,6 +328,13 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
     fprintf(stderr, "%s", cmdopt->usgs);
     exit(1);
   }
+  /* a memory image replaces the logger, and so excludes any device */
+  if (cmdopt->imgs != NULL && (cmdopt->devs != NULL || cmdopt->btas != NULL ||
+			       cmdopt->spds != NULL || cmdopt->caps != NULL ||
+			       cmdopt->flts != NULL)) {
+    fprintf(stderr, "%s", cmdopt->usgs);
+    exit(1);
+  }
 
 #if !ENABLE_LINUX_BT-0
   if (cmdopt->btas != NULL) {
@@ -209,7 +342,7 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
     exit(1);
   }
   /* bluetooth not enabled and Serial device name not provided */
-  if (cmdopt->devs == NULL) {
+  if (cmdopt->devs == NULL && cmdopt->imgs == NULL) {
     fprintf(stderr, "%s", cmdopt->usgs);
     exit(1);
   }
@@ -233,6 +366,34 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
     }
     cmdopt->sspd = baudi;
   }
+  /* transfer baud rate is only valid for a serial device */
+  if (cmdopt->xspds != NULL && cmdopt->devs == NULL) {
+    fprintf(stderr, "%s", cmdopt->usgs);
+    exit(1);
+  }
+  if (cmdopt->xspds != NULL) {
+    int baudi;
+    if(sscanf(cmdopt->xspds, "%d", &baudi) != 1 || baudi < 0) {
+      fprintf(stderr, "rtkgps: Flag -x may only take unsigned "
+	      "integer values\n");
+      exit(1);
+    }
+    if( !dev_speed_valid(baudi)){
+      fprintf(stderr, "rtkgps: Unsupported baud rate: %d\n", baudi);
+      exit(1);
+    }
+    if ((unsigned int)baudi != cmdopt->sspd)
+      cmdopt->xspd = baudi;
+  }
+
+  if (cmdopt->wins != NULL) {
+    if (sscanf(cmdopt->wins, "%d", &cmdopt->dwin) != 1 || cmdopt->dwin < 1 ||
+	cmdopt->dwin > XFER_MXWIN) {
+      fprintf(stderr, "rtkgps: Flag -w may only take integer values "
+	      "from 1 to 16\n");
+      exit(1);
+    }
+  }
 
   if (optind < argc)
     cmdopt->cmds = argv[optind++];
@@ -245,19 +406,27 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
        strcmp(cmdopt->cmds,"list") != 0 &&
        strcmp(cmdopt->cmds,"read") != 0 &&
        strcmp(cmdopt->cmds,"set") != 0 &&
-       strcmp(cmdopt->cmds,"erase") != 0) ||
+       strcmp(cmdopt->cmds,"erase") != 0 &&
+       strcmp(cmdopt->cmds,"dump") != 0 &&
+       strcmp(cmdopt->cmds,"split") != 0) ||
       (strcmp(cmdopt->cmds,"status") != 0 && cmdopt->eflg) ||
       (strcmp(cmdopt->cmds,"set") != 0 && cmdopt->cfls) ||
       (strcmp(cmdopt->cmds,"set") != 0 && cmdopt->lgts) ||
       (strcmp(cmdopt->cmds,"set") != 0 && cmdopt->mfos) ||
       (strcmp(cmdopt->cmds,"set") != 0 && cmdopt->snts) ||
-      (strcmp(cmdopt->cmds,"read") != 0 && cmdopt->dsts != NULL) ||
-      (strcmp(cmdopt->cmds,"read") != 0 && cmdopt->nflg) ||
-      (strcmp(cmdopt->cmds,"read") != 0 && cmdopt->pflg) ||
+      (strcmp(cmdopt->cmds,"read") != 0 && strcmp(cmdopt->cmds,"dump") != 0 &&
+       strcmp(cmdopt->cmds,"split") != 0 && cmdopt->dsts != NULL) ||
+      (strcmp(cmdopt->cmds,"read") != 0 && strcmp(cmdopt->cmds,"split") != 0 &&
+       cmdopt->nflg) ||
+      (strcmp(cmdopt->cmds,"read") != 0 && strcmp(cmdopt->cmds,"dump") != 0 &&
+       cmdopt->pflg) ||
       (strcmp(cmdopt->cmds,"read") != 0 && cmdopt->uflg) ||
-      (strcmp(cmdopt->cmds,"read") != 0 && cmdopt->dsts) ||
-      (strcmp(cmdopt->cmds,"read") != 0 && cmdopt->flns) ||
-      (strcmp(cmdopt->cmds,"erase") != 0 && cmdopt->yflg)) {
+      (strcmp(cmdopt->cmds,"read") != 0 && strcmp(cmdopt->cmds,"split") != 0 &&
+       cmdopt->flns) ||
+      (strcmp(cmdopt->cmds,"read") != 0 && strcmp(cmdopt->cmds,"dump") != 0 &&
+       cmdopt->xspds) ||
+      (strcmp(cmdopt->cmds,"erase") != 0 && cmdopt->yflg) ||
+      ((strcmp(cmdopt->cmds,"split") != 0) != (cmdopt->imgs == NULL))) {
     fprintf(stderr, "%s", cmdopt->usgs);
     exit(1);
   }
@@ -270,9 +439,11 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
     }
     if (cmdopt->lgts != NULL && strcmp(cmdopt->lgts,"tl") != 0 &&
 	strcmp(cmdopt->lgts,"tla") != 0 &&
-	strcmp(cmdopt->lgts,"tlav") != 0) {
+	strcmp(cmdopt->lgts,"tlav") != 0 &&
+	strcmp(cmdopt->lgts,"tlavd") != 0 &&
+	strcmp(cmdopt->lgts,"tlavds") != 0) {
       fprintf(stderr, "rtkgps: Flag -l for set command may only take values"
-	      "\"tl\", \"tla\", or \"tlav\"\n");
+	      "\"tl\", \"tla\", \"tlav\", \"tlavd\", or \"tlavds\"\n");
       exit(1);
     }
     if (cmdopt->mfos != NULL && strcmp(cmdopt->mfos,"o") != 0 &&
@@ -320,8 +491,8 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
 	cmdopt->fnmn > cmdopt->fnmx)
       strvld = 0;
     if (!strvld) {
-      fprintf(stderr, "rtkgps: Flag -f for read command has invalid "
-	      "file number specification string\n");
+      fprintf(stderr, "rtkgps: Flag -f for %s command has invalid "
+	      "file number specification string\n", cmdopt->cmds);
       exit(1);
     }
   }
@@ -338,86 +509,97 @@ void scan_cmdline(int argc, char* argv[], cmdlnopts_t *cmdopt) {
  Perform rtkgps status command.
  *****************************************************************************/
 void cmd_status(cmdlnopts_t *cmdopt) {
-  int fd;
+  rtk_session_t *sp;
   unsigned int mu = 0;
   status_t status;
   logfile_t lgfl;
   log_bndry_t lgbd;
   memory_t mem;
   firmware_t frm;
+  logcache_t lc;
 
-  fd = coms_open(cmdopt);
+  sp = coms_open(cmdopt);
 
   if (cmdopt->vflg)
     printf("Requesting logger status information\n");
 
-  status_read(fd, &status, cmdopt);
+  status_read(sp, &status, cmdopt);
 
   if (cmdopt->eflg) {
     if (cmdopt->vflg)
       printf("Requesting extended logger information\n");
 
-    gpsmouse_disable(fd, status.gpsms, cmdopt);
+    gpsmouse_disable(sp, status.gpsms, cmdopt);
 
-    if (get_log_bndry(fd, &lgbd) < 0) {
+    if (get_log_bndry(sp, &lgbd) < 0) {
       fprintf(stderr,"rtkgps: Failed to read log start/end details [%s]\n",
-	      gcstrerror(rcerrno));
-      gpsmouse_enable(fd, status.gpsms, cmdopt);
-      coms_close(fd, cmdopt);
+	      gcstrerror(sp));
+      gpsmouse_enable(sp, status.gpsms, cmdopt);
+      coms_close(sp, cmdopt);
       exit(5);
     }
-    if (get_memory_info(fd, &mem) < 0) {
+    /* Memory, firmware and complete log file details are taken from
+       the metadata cache where possible */
+    metadata_cache_open(sp, &lc, &lgbd, &status, cmdopt);
+    if (memory_info(sp, &lc, &mem) < 0) {
       fprintf(stderr,"rtkgps: Failed to read logger memory details [%s]\n",
-	      gcstrerror(rcerrno));
-      gpsmouse_enable(fd, status.gpsms, cmdopt);
-      coms_close(fd, cmdopt);
+	      gcstrerror(sp));
+      gpsmouse_enable(sp, status.gpsms, cmdopt);
+      coms_close(sp, cmdopt);
       exit(5);
     }
-    if (get_firmware_info(fd, &frm) < 0) {
-      fprintf(stderr,"rtkgps: Failed to read logger firmware details [%s]\n",
-	      gcstrerror(rcerrno));
-      gpsmouse_enable(fd, status.gpsms, cmdopt);
-      coms_close(fd, cmdopt);
-      exit(5);
+    if (!logcache_firmware_get(&lc, &frm)) {
+      if (get_firmware_info(sp, &frm) < 0) {
+	fprintf(stderr,"rtkgps: Failed to read logger firmware details "
+		"[%s]\n", gcstrerror(sp));
+	gpsmouse_enable(sp, status.gpsms, cmdopt);
+	coms_close(sp, cmdopt);
+	exit(5);
+      }
+      logcache_firmware_put(&lc, &frm);
     }
      /* Get info for first logfile */
-    if (get_file_info(fd, 0, &lgfl) < 0) {
+    if (file_info(sp, &lc, 0, &lgfl) < 0) {
       fprintf(stderr,"rtkgps: Error reading information for file %d [%s]\n",
-	      0, gcstrerror(rcerrno));
-      gpsmouse_enable(fd, status.gpsms, cmdopt);
-      coms_close(fd, cmdopt);
+	      0, gcstrerror(sp));
+      gpsmouse_enable(sp, status.gpsms, cmdopt);
+      coms_close(sp, cmdopt);
       exit(5);
     } 
     if (lgfl.memp == 0) { /* Memory has not wrapped around in overwrite mode */
       /* Get info for last logfile */
-      if (get_file_info(fd, status.nfile-1, &lgfl) < 0) {
+      if (get_file_info(sp, status.nfile-1, &lgfl) < 0) {
 	fprintf(stderr,"rtkgps: Error reading information for file %d [%s]\n",
-		status.nfile-1, gcstrerror(rcerrno));
-	gpsmouse_enable(fd, status.gpsms, cmdopt);
-	coms_close(fd, cmdopt);
+		status.nfile-1, gcstrerror(sp));
+	gpsmouse_enable(sp, status.gpsms, cmdopt);
+	coms_close(sp, cmdopt);
 	exit(5);
       }
       /* Memory used computed from last logfile pointer plus number of 
 	 fixes in active logfile */
       mu = lgfl.memp + status.nfix*fix_size(status.fxtyp);
     } else { /* Memory has wrapped around in overwrite mode */
-      int n;
+      file_size_sum_t fss = {&lc, 0};
+      short int n;
+
       /* Need to compute memory used by adding up number of fixes in each 
 	 log file */
-      mu = lgfl.nfix*fix_size(lgfl.fxtyp);
-      for (n = 1; n < status.nfile; n++) {
-	if (get_file_info(fd, n, &lgfl) < 0) {
-	  fprintf(stderr,"rtkgps: Error reading information for file "
-                 "%d [%s]\n", n, gcstrerror(rcerrno));
-	  gpsmouse_enable(fd, status.gpsms, cmdopt);
-	  coms_close(fd, cmdopt);
-	  exit(5);
-	}
-	mu += lgfl.nfix*fix_size(lgfl.fxtyp);
+      fss.mu = lgfl.nfix*fix_size(lgfl.fxtyp);
+      for (n = 1; n < status.nfile && logcache_file_get(&lc, n, &lgfl, NULL);
+	   n++)
+	fss.mu += lgfl.nfix*fix_size(lgfl.fxtyp);
+      if (get_files_info(sp, n, status.nfile-n, cmdopt->dwin, file_info_size,
+			 &fss) < 0) {
+	fprintf(stderr,"rtkgps: Error reading log file information [%s]\n",
+		gcstrerror(sp));
+	gpsmouse_enable(sp, status.gpsms, cmdopt);
+	coms_close(sp, cmdopt);
+	exit(5);
       }
+      mu = fss.mu;
     }
 
-    gpsmouse_enable(fd, status.gpsms, cmdopt);
+    gpsmouse_enable(sp, status.gpsms, cmdopt);
   }
 
   printf("GPS Fix:            %s\nGPS mouse mode:     %s\n"
@@ -443,7 +625,7 @@ void cmd_status(cmdlnopts_t *cmdopt) {
 	   "Firmware:           %s\n", frm.vrsnr, frm.frmwr);
   }
 
-  coms_close(fd, cmdopt);
+  coms_close(sp, cmdopt);
 }
 
 
@@ -451,25 +633,25 @@ void cmd_status(cmdlnopts_t *cmdopt) {
  Perform rtkgps date command.
  *****************************************************************************/
 void cmd_date(cmdlnopts_t *cmdopt) {
-  int fd;
+  rtk_session_t *sp;
   date_time_t dttm;
 
-  fd = coms_open(cmdopt);
+  sp = coms_open(cmdopt);
 
   if (cmdopt->vflg)
     printf("Determining current date/time information\n");
 
-  if (get_current_utc(fd, &dttm) < 0) {
+  if (get_current_utc(sp, &dttm) < 0) {
     fprintf(stderr,"rtkgps: Failed to determine current date/time [%s]\n",
-	    gcstrerror(rcerrno));
-    coms_close(fd, cmdopt);
+	    gcstrerror(sp));
+    coms_close(sp, cmdopt);
     exit(5);
   }
 
   printf("%.4s-%.2s-%.2s %.2s:%.2s:%.2s\n", dttm.date,dttm.date+4,
 	 dttm.date+6,dttm.time, dttm.time+2, dttm.time+4);
 
-  coms_close(fd, cmdopt);
+  coms_close(sp, cmdopt);
 }
 
 
@@ -477,50 +659,41 @@ void cmd_date(cmdlnopts_t *cmdopt) {
  Perform rtkgps list command.
  *****************************************************************************/
 void cmd_list(cmdlnopts_t *cmdopt) {
-  int fd;
+  rtk_session_t *sp;
   status_t status;
-  logfile_t *lgflp;
-  /*unsigned int mem = 0;*/
-  int n;
+  logcache_t lc;
+  logfile_t lgfl;
+  short int n;
 
-  fd = coms_open(cmdopt);
+  sp = coms_open(cmdopt);
 
   if (cmdopt->vflg)
     printf("Requesting logger status information\n");
 
-  status_read(fd, &status, cmdopt);
+  status_read(sp, &status, cmdopt);
 
-  gpsmouse_disable(fd, status.gpsms, cmdopt);
+  gpsmouse_disable(sp, status.gpsms, cmdopt);
 
-  if ((lgflp = malloc(status.nfile*sizeof(logfile_t))) == NULL) {
-    fprintf(stderr,"rtkgps: Error allocating memory\n");
-    gpsmouse_enable(fd, status.gpsms, cmdopt);
-    coms_close(fd, cmdopt);
-    exit(2);
-  }
+  /* Each line of the listing is printed as the metadata for the file
+     is received, after those of the files in the metadata cache */
+  metadata_cache_open(sp, &lc, NULL, &status, cmdopt);
+  printf("File num   Date      Fix type  Num fix  Mem ptr\n");
+  for (n = 0; n < status.nfile && logcache_file_get(&lc, n, &lgfl, NULL); n++)
+    file_info_print(n, &lgfl, NULL);
 
-  for (n = 0; n < status.nfile; n++) {
-    if (cmdopt->vflg) {
-      printf("Requesting metadata for file %4d\n", n);
-    }
-    if (get_file_info(fd, n, lgflp+n) < 0) {
-      fprintf(stderr,"rtkgps: Error reading information for file %d [%s]\n",
-	      n, gcstrerror(rcerrno));
-      free(lgflp);
-      gpsmouse_enable(fd, status.gpsms, cmdopt);
-      coms_close(fd, cmdopt);
-      exit(5);
-    }
+  if (cmdopt->vflg)
+    printf("Requesting metadata for %d files\n", status.nfile - n);
+  if (get_files_info(sp, n, status.nfile-n, cmdopt->dwin, file_info_print,
+		     &lc) < 0) {
+    fprintf(stderr,"rtkgps: Error reading log file information [%s]\n",
+	    gcstrerror(sp));
+    gpsmouse_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(5);
   }
 
-  printf("File num   Date      Fix type  Num fix  Mem ptr\n");
-  for (n = 0; n < status.nfile; n++)
-    printf("%8d   %8s  %8hd  %7d  %7d\n", n, lgflp[n].date, lgflp[n].fxtyp,
-	   lgflp[n].nfix, lgflp[n].memp);
-
-  free(lgflp);
-  gpsmouse_enable(fd, status.gpsms, cmdopt);
-  coms_close(fd, cmdopt);
+  gpsmouse_enable(sp, status.gpsms, cmdopt);
+  coms_close(sp, cmdopt);
 }
 
 
@@ -528,16 +701,16 @@ void cmd_list(cmdlnopts_t *cmdopt) {
  Perform rtkgps set command.
  *****************************************************************************/
 void cmd_set(cmdlnopts_t *cmdopt) {
-  int fd;
+  rtk_session_t *sp;
   status_t status;
   unsigned char cflg = 0, fxtp = 0, mfow = 0, gpsm;
 
-  fd = coms_open(cmdopt);
+  sp = coms_open(cmdopt);
 
   if (cmdopt->vflg) {
     printf("Requesting logger status information\n");
   }
-  status_read(fd, &status, cmdopt);
+  status_read(sp, &status, cmdopt);
 
   gpsm = status.gpsms;
   if (cmdopt->cfls != NULL) {
@@ -553,6 +726,10 @@ void cmd_set(cmdlnopts_t *cmdopt) {
       fxtp = 1;
     else if (strcmp(cmdopt->lgts,"tlav") == 0)
       fxtp = 2;
+    else if (strcmp(cmdopt->lgts,"tlavd") == 0)
+      fxtp = 3;
+    else if (strcmp(cmdopt->lgts,"tlavds") == 0)
+      fxtp = 4;
     if (fxtp != status.fxtyp) {
       status.fxtyp = fxtp;
       cflg = 1;
@@ -574,26 +751,26 @@ void cmd_set(cmdlnopts_t *cmdopt) {
   }
 
   if (cflg == 1) {
-    gpsmouse_disable(fd, status.gpsms, cmdopt);
+    gpsmouse_disable(sp, status.gpsms, cmdopt);
     if (cmdopt->vflg) {
       printf("Setting new logger parameters\n");
     }
-    if (set_status(fd, &status) < 0) {
+    if (set_status(sp, &status) < 0) {
       fprintf(stderr,"rtkgps: Failed to set device status [%s]\n",
-	      gcstrerror(rcerrno));
-      gpsmouse_enable(fd, gpsm, cmdopt);
-      coms_close(fd, cmdopt);
+	      gcstrerror(sp));
+      gpsmouse_enable(sp, gpsm, cmdopt);
+      coms_close(sp, cmdopt);
       exit(5);
     }
-    gpsmouse_enable(fd, gpsm, cmdopt);
+    gpsmouse_enable(sp, gpsm, cmdopt);
   } else {
     if (gpsm && !status.gpsms)
-      gpsmouse_enable(fd, gpsm, cmdopt);
+      gpsmouse_enable(sp, gpsm, cmdopt);
     else if (!gpsm && status.gpsms)
-      gpsmouse_disable(fd, status.gpsms, cmdopt);
+      gpsmouse_disable(sp, status.gpsms, cmdopt);
   }
 
-  coms_close(fd, cmdopt);
+  coms_close(sp, cmdopt);
 
 }
 
@@ -602,12 +779,17 @@ void cmd_set(cmdlnopts_t *cmdopt) {
  Perform rtkgps read command.
  *****************************************************************************/
 void cmd_read(cmdlnopts_t *cmdopt) {
-  int fd;
+  rtk_session_t *sp;
   status_t status;
+  memory_t mem;
+  xfer_t xfer;
+  logcache_t lc;
+  file_table_t ft;
   geoid_height_t gdht = {0,0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,NULL,NULL};
   FILE *strm = NULL;
   char *fnam = NULL;
-  short int n;
+  short int n, nswp;
+  int ec;
 
 #ifdef GEOIDCOR
   /* Set up geoid correction data structure */
@@ -618,127 +800,109 @@ void cmd_read(cmdlnopts_t *cmdopt) {
 #endif
 
   /* Open communication with logger */
-  fd = coms_open(cmdopt);
+  sp = coms_open(cmdopt);
 
   /* Set up progress bar if requested */
-  if (cmdopt->pflg) {
-#ifdef HAVE_TIOCGWINSZ
-     struct winsize ws;
-     if (ioctl(1, TIOCGWINSZ, (void *)&ws) == 0)
-       prgbrfp = 1;
-     else if (ioctl(2, TIOCGWINSZ, (void *)&ws) == 0)
-       prgbrfp = 2;
-#else
-     prgbrfp = 1;
-#endif
-     if (prgbrfp)
-       gdpfp = get_data_progress;
-  }
+  if (cmdopt->pflg)
+    progress_bar_enable(sp);
+  sp->gdcfp = get_data_checkpoint;
 
   if (cmdopt->vflg)
     printf("Requesting logger status information\n");
 
   /* Read logger status */
-  status_read(fd, &status, cmdopt);
-
- /* Handle unspecified ends of file number range */
-  if (cmdopt->fnmn == -1)
-    cmdopt->fnmn = 0;
-  if (cmdopt->fnmx == -1)
-    cmdopt->fnmx = status.nfile-1;
+  status_read(sp, &status, cmdopt);
 
-  /* Check for minimum file number out of range */
-  if (cmdopt->fnmn >= status.nfile) {
-    fprintf(stderr,"rtkgps: Requested file number(s) all invalid\n");
-    coms_close(fd, cmdopt);
+  /* Check requested range of file numbers */
+  if (file_range(cmdopt, status.nfile) < 0) {
+    coms_close(sp, cmdopt);
     exit(1);
   }
 
-  /* Check for maximum file number out of range */
-  if (cmdopt->fnmx >= status.nfile) {
-    cmdopt->fnmx = status.nfile-1;
-    fprintf(stderr, "rtkgps:  Warning: reduced maximum requested file "
-	    "number to valid range\n");
-  }
+  outlog_disable(sp, cmdopt);
 
-  outlog_disable(fd, cmdopt);
+  /* Complete log file details are taken from the metadata cache where
+     possible */
+  metadata_cache_open(sp, &lc, NULL, &status, cmdopt);
 
-  /* The complicated handling of output files, split between this function 
-     and file_read, is due to the following output policy:
-     • If no output file is specified, selected logfiles are written 
-       to stdout
-     • If the specified output file is a regular file, all selected logfiles
-       are written to that file
-     • If the specified output file is a directory, each selected logfile is
-       written to a unique file within that directory  
-  */
-  if (cmdopt->dsts == NULL)
-    strm = stdout; /* If output flag not specified, output stream is stdout */
-  else {
-    /* If output flag is specified, determine whether it is a directory */
-    if (is_directory(cmdopt->dsts)) {
-      /* If specified output path is a directory, allocate memory for
-	 constructing the full output filename */
-      if ((fnam = malloc(strlen(cmdopt->dsts) + 32)) == NULL) {
-	fprintf(stderr,"rtkgps: Error allocating memory\n");
-	outlog_enable(fd, status.gpsms, cmdopt);
-	coms_close(fd, cmdopt);
-	exit(2);
-      }
-    } else {
-      /* If specified output path is not a directory, open the file
-	 for writing after creating a backup if the file already exists. */
-      if (file_backup(cmdopt->dsts) != 0) {
-	fprintf(stderr,"rtkgps: Error creating backup of file %s\n",
-		cmdopt->dsts);
-	outlog_enable(fd, status.gpsms, cmdopt);
-	coms_close(fd, cmdopt);
-	exit(3);
-      }
-      if ((strm = fopen(cmdopt->dsts, "w")) == NULL) {
-	fprintf(stderr,"rtkgps: Error opening output file %s [%s]\n",
-		cmdopt->dsts, gcstrerror(rcerrno));
-	outlog_enable(fd, status.gpsms, cmdopt);
-	coms_close(fd, cmdopt);
-	exit(3);
-      }
-    }
+  /* Read the memory sector size, to which data requests are aligned */
+  if (memory_info(sp, &lc, &mem) < 0) {
+    fprintf(stderr, "rtkgps: Warning: failed to read logger memory "
+	    "details [%s]\n", gcstrerror(sp));
+    mem.sctrsz = 0;
   }
+  xfer_init(&xfer, cmdopt->dwin, mem.sctrsz);
 
-  if (strm != NULL) {
-    /* Write output file header */
-    if (cmdopt->nflg)
-      print_hdr_native(strm);
-    else
-      print_hdr_nmea(strm, cmdopt->btas);
+  /* Read metadata for the requested range of log files */
+  ft.lcp = &lc;
+  ft.lgflp = malloc(status.nfile*sizeof(logfile_t));
+  ft.timep = calloc(status.nfile, sizeof(*ft.timep));
+  if (ft.lgflp == NULL || ft.timep == NULL) {
+    fprintf(stderr,"rtkgps: Error allocating memory\n");
+    outlog_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(2);
+  }
+  if (file_table(sp, &ft, cmdopt->fnmn, cmdopt->fnmx, cmdopt) < 0) {
+    fprintf(stderr,"rtkgps: Error reading log file information [%s]\n",
+	    gcstrerror(sp));
+    outlog_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(5);
+  }
+
+  /* Switch to data transfer line speed if requested */
+  xfer_speed_enable(sp, cmdopt);
+
+  /* Open the output file, or allocate memory for constructing output
+     file names if the output path is a directory */
+  if ((ec = output_open(cmdopt, &strm, &fnam)) != 0) {
+    xfer_speed_restore(sp, cmdopt);
+    outlog_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(ec);
   }
 
   /* Reset warning function message records */
-  warning(NULL, 0, NULL);
+  warning(sp, NULL, 0, NULL);
 
-  /* Read requested range of log files */
-  for (n = cmdopt->fnmn; n <= cmdopt->fnmx; n++) {
+  /* Read requested range of log files. Runs of log files that follow
+     each other in logger memory are retrieved by a single sweep, and
+     the remaining log files one at a time. */
+  for (n = cmdopt->fnmn; n <= cmdopt->fnmx; n += nswp) {
     char nstr[8];
 
-    /* If progress bar requested and verbose output not enabled, set
-       up prefix displaying file number */
-    if (cmdopt->pflg && !cmdopt->vflg) {
-      sprintf(nstr, "%4d ", n);
-      text_progress_bar(0.0, nstr);
+    nswp = sweep_select(sp, &ft, n, cmdopt->fnmx, fnam, &status, cmdopt);
+    if (nswp > 1)
+      sweep_read(sp, &ft, n, nswp, fnam, strm, &gdht, &status, &xfer,
+		 cmdopt);
+    else {
+      nswp = 1;
+      /* If progress bar requested and verbose output not enabled, set
+	 up prefix displaying file number */
+      if (cmdopt->pflg && !cmdopt->vflg) {
+	sprintf(nstr, "%4d ", n);
+	text_progress_bar(0.0, nstr);
+      }
+      file_read(sp, n, &ft, fnam, strm, &gdht, &status, &xfer, cmdopt);
     }
-    file_read(fd, n, fnam, strm, &gdht, &status, cmdopt);
 
     /* Reset warning function message records */
-    warning(NULL, 0, NULL);
+    warning(sp, NULL, 0, NULL);
   }
 
-  /* Free memory allocated for file name */
+  /* Free memory allocated for file name and file table */
   free(fnam);
+  free(ft.lgflp);
+  free(ft.timep);
 
-  outlog_enable(fd, status.gpsms, cmdopt);
+  xfer_report(&xfer, cmdopt);
+  xfer_speed_restore(sp, cmdopt);
+
+  outlog_enable(sp, status.gpsms, cmdopt);
 
   /* Close ommunication with logger */
-  coms_close(fd, cmdopt);
+  coms_close(sp, cmdopt);
 
 #ifdef GEOIDCOR
    /* Destroy geoid correction data structure */
@@ -751,7 +915,7 @@ void cmd_read(cmdlnopts_t *cmdopt) {
   Perform rtkgps erase command.
  *****************************************************************************/
 void cmd_erase(cmdlnopts_t *cmdopt) {
-  int fd;
+  rtk_session_t *sp;
   int ce;
 
   ce = cmdopt->yflg;
@@ -762,150 +926,603 @@ void cmd_erase(cmdlnopts_t *cmdopt) {
   }
 
   if (ce) {
-    fd = coms_open(cmdopt);
+    sp = coms_open(cmdopt);
 
     if (cmdopt->vflg) {
       printf("Erasing memory\n");
     }
 
-    if (set_memory_erase(fd) < 0) {
+    if (set_memory_erase(sp) < 0) {
       fprintf(stderr,"rtkgps: Memory erase command not confirmed [%s]\n",
-	      gcstrerror(rcerrno));
-      coms_close(fd, cmdopt);
+	      gcstrerror(sp));
+      coms_close(sp, cmdopt);
       exit(5);
     }
 
-    coms_close(fd, cmdopt);
+    coms_close(sp, cmdopt);
   } else if (cmdopt->vflg)
     printf("Erase operation aborted\n");
 }
 
 
 /*****************************************************************************
- Get data progress callback function.
+ Perform rtkgps dump command.
  *****************************************************************************/
-void get_data_progress(unsigned short nfxt, unsigned short nfxc) {
-  text_progress_bar((float)nfxc/(float)nfxt, NULL);
-  if (nfxc == nfxt)
-    fprintf(stderr,"\n");
-}
+void cmd_dump(cmdlnopts_t *cmdopt) {
+  rtk_session_t *sp;
+  status_t status;
+  memory_t mem;
+  xfer_t xfer;
+  logcache_t lc;
+  file_table_t ft;
+  FILE *strm = stdout;
+  char nstr[16];
+
+  /* The image is written as a single file */
+  if (cmdopt->dsts != NULL && is_directory(cmdopt->dsts)) {
+    fprintf(stderr,"rtkgps: Output of dump command must be a file\n");
+    exit(1);
+  }
 
+  /* If the image is written to standard output, it is given its own
+     stream on a duplicate of the standard output descriptor, which is
+     then redirected to standard error, so that verbose and progress
+     output does not corrupt the image */
+  if (cmdopt->dsts == NULL) {
+    int fd;
+    fflush(stdout);
+    if ((fd = dup(STDOUT_FILENO)) < 0 || (strm = fdopen(fd, "w")) == NULL ||
+	dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+      fprintf(stderr,"rtkgps: Error redirecting standard output [%s]\n",
+	      strerror(errno));
+      exit(3);
+    }
+  }
 
-/*****************************************************************************
- Display text progress bar.
- *****************************************************************************/
-void text_progress_bar(float frac, const char *prfs) {
-  static const char *prfx = "";
-  static unsigned short nbpv = 0;
-  static unsigned short ncol = 0;
-  static unsigned short bmax = 0;
-  static char bar[] = "================================================="
-    "==================================================================="
-    "===================================================================";
-  static char spc[] = "                                                 "
-    "                                                                   "
-    "                                                                   "
-    "                                                                   ";
+  /* Open communication with logger */
+  sp = coms_open(cmdopt);
 
-  if (prfs == NULL && prgbrfp) {
-    FILE *fp = NULL;
-    unsigned short nbar;
+  /* Set up progress bar if requested */
+  if (cmdopt->pflg)
+    progress_bar_enable(sp);
 
-    /* Set output file pointer based on file descriptor in prgbrfp */
-    if (prgbrfp == 1)
-      fp = stdout;
-    else if (prgbrfp == 2)
-      fp = stderr;
-    else
-      return;
+  if (cmdopt->vflg)
+    printf("Requesting logger status information\n");
 
-#ifdef HAVE_TIOCGWINSZ
-    {
-      struct winsize ws;
-      if (ioctl(prgbrfp, TIOCGWINSZ, (void *)&ws) == 0)
-        ncol = ws.ws_col;
-      else
-        return;
-    }
-#else
-    ncol = 40;
-#endif
+  /* Read logger status */
+  status_read(sp, &status, cmdopt);
+
+  outlog_disable(sp, cmdopt);
+
+  /* Memory and complete log file details are taken from the metadata
+     cache where possible */
+  metadata_cache_open(sp, &lc, NULL, &status, cmdopt);
+  if (memory_info(sp, &lc, &mem) < 0) {
+    fprintf(stderr,"rtkgps: Failed to read logger memory details [%s]\n",
+	    gcstrerror(sp));
+    outlog_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(5);
+  }
+  xfer_init(&xfer, cmdopt->dwin, mem.sctrsz);
 
-    if (frac < 0) {
-      /* Print spaces to clear current progress bar line */
-      fprintf(fp, "%.*s\r", (int)((ncol < strlen(spc))?ncol:strlen(spc)), spc);
-      fflush(fp);
-    } else {
-      /* Compute length of current progress bar */
-      bmax = ncol - strlen(prfx) - 7;
-      if (bmax > strlen(bar))
-	bmax = strlen(bar);
-      nbar = (unsigned short)floor(frac*bmax);
-      if (nbar > bmax)
-	nbar = bmax;
+  if ((ft.lgflp = malloc((status.nfile+1)*sizeof(logfile_t))) == NULL) {
+    fprintf(stderr,"rtkgps: Error allocating memory\n");
+    outlog_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(2);
+  }
+  ft.lcp = &lc;
+  ft.timep = NULL;
+  if (file_table(sp, &ft, 0, status.nfile-1, cmdopt) < 0) {
+    fprintf(stderr,"rtkgps: Error reading log file information [%s]\n",
+	    gcstrerror(sp));
+    free(ft.lgflp);
+    outlog_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(5);
+  }
 
-      /* If progress bar length has changed, print new line and update
-	 previous bar length */
-      if (nbar != nbpv) {
-	nbpv = nbar;
-	fprintf(fp, "%s|%.*s%.*s| %3.0f%%\r", prfx, nbar, bar, bmax-nbar,
-		spc, 100.0*frac);
-	fflush(fp);
-      }
+  /* Open the output file after creating a backup if it already exists */
+  if (cmdopt->dsts != NULL) {
+    if (file_backup(cmdopt->dsts) != 0) {
+      fprintf(stderr,"rtkgps: Error creating backup of file %s\n",
+	      cmdopt->dsts);
+      free(ft.lgflp);
+      outlog_enable(sp, status.gpsms, cmdopt);
+      coms_close(sp, cmdopt);
+      exit(3);
     }
-  } else
-    prfx = prfs;
+    if ((strm = fopen(cmdopt->dsts, "w")) == NULL) {
+      fprintf(stderr,"rtkgps: Error opening output file %s [%s]\n",
+	      cmdopt->dsts, strerror(errno));
+      free(ft.lgflp);
+      outlog_enable(sp, status.gpsms, cmdopt);
+      coms_close(sp, cmdopt);
+      exit(3);
+    }
+  }
+  dump_write_header(strm, &mem, status.nfile, ft.lgflp);
+
+  /* Switch to data transfer line speed if requested */
+  xfer_speed_enable(sp, cmdopt);
+
+  /* Reset warning function message records */
+  warning(sp, NULL, 0, NULL);
+
+  /* The records of all log files are retrieved as a single sequence
+     of data requests, and written, in order, as they are stored in
+     logger memory, without being decoded, as they are received */
+  if (cmdopt->pflg && !cmdopt->vflg) {
+    sprintf(nstr, "%4d-%d ", 0, status.nfile - 1);
+    text_progress_bar(0.0, nstr);
+  }
+  if (cmdopt->vflg)
+    printf("Requesting content of files  %4d-%d\n", 0, status.nfile - 1);
+  sp->gdrfp = get_data_raw;
+  sp->arg = strm;
+  if (get_files_raw(sp, ft.lgflp, status.nfile, &xfer) < 0) {
+    fprintf(stderr,"rtkgps: Error reading files %d-%d [%s]\n",
+	    0, status.nfile - 1, gcstrerror(sp));
+    free(ft.lgflp);
+    /* An incomplete image is of no use, so it is removed */
+    if (cmdopt->dsts != NULL)
+      remove(cmdopt->dsts);
+    xfer_speed_restore(sp, cmdopt);
+    outlog_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(5);
+  }
+  sp->gdrfp = NULL;
+
+  free(ft.lgflp);
+
+  if (fflush(strm) != 0 || ferror(strm)) {
+    fprintf(stderr,"rtkgps: Error writing memory image [%s]\n",
+	    strerror(errno));
+    if (cmdopt->dsts != NULL)
+      remove(cmdopt->dsts);
+    xfer_speed_restore(sp, cmdopt);
+    outlog_enable(sp, status.gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(3);
+  }
+  fclose(strm);
+
+  xfer_report(&xfer, cmdopt);
+  xfer_speed_restore(sp, cmdopt);
+
+  outlog_enable(sp, status.gpsms, cmdopt);
+
+  /* Close communication with logger */
+  coms_close(sp, cmdopt);
 }
 
 
 /*****************************************************************************
- Warning display function.
+ Perform rtkgps split command.
  *****************************************************************************/
-#if defined(__GNUC__) && !defined(DEBUG)
-void warning(const char *wrn, int line __attribute__((unused)), 
-	     const char *file __attribute__((unused))) {
-#else
-void warning(const char *wrn, int line, const char *file) {
-#endif
-  static char wmsg[20][256];
-  static uint8_t nmsg = 0;
+void cmd_split(cmdlnopts_t *cmdopt) {
+  rtk_session_t *sp;
+  dump_t dump;
+  geoid_height_t gdht = {0,0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,NULL,NULL};
+  FILE *strm = NULL;
+  char *fnam = NULL;
+  short int n;
+  int ec;
 
-  if (wrn == NULL) {
-    /* Reset warning message records if function called with null string */
-    nmsg = 0;
-  } else {
-    /* Record and print non-null string */
-    uint8_t msn = 0;
-    uint8_t n = 0;
+  if (cmdopt->vflg)
+    printf("Reading memory image %s\n", cmdopt->imgs);
 
-#ifdef DEBUG
-    /* When debugging, print every message */
-    msn = 1;
-#else
-    /* Determine whether error message has already been encountered */
-    for (n = 0; n < nmsg; n++) {
-      if (strncmp(wrn, wmsg[n], 255) == 0) {
-	msn = 1;
-	break;
-      }
-    }
-#endif
+  if (dump_read(cmdopt->imgs, &dump) < 0) {
+    fprintf(stderr,"rtkgps: Error reading memory image %s [%s]\n",
+	    cmdopt->imgs, strerror(errno));
+    exit(3);
+  }
 
-    if (!msn) {
-      /* Current error message has not already been encountered */
-#ifndef DEBUG
-      /* When debugging, no need to record messages */
-      if (nmsg < 20) {
-	strncpy(wmsg[n], wrn, 255);
-	wmsg[n][255] = '\0';
-	nmsg++;
-      }
-#endif
+  if (file_range(cmdopt, dump.nfile) < 0) {
+    dump_free(&dump);
+    exit(1);
+  }
 
-      /* If progress bar file descriptor is not zero, call progress bar
-	 function with request to clear current progress bar line. */
-      if (prgbrfp)
-	text_progress_bar(-1.0, NULL);
+#ifdef GEOIDCOR
+  /* Set up geoid correction data structure */
+  if (geoid_calc_open(GGRDPATH, &gdht) == -1) {
+    fprintf(stderr, "rtkgps: Warning: could not access geoid correction "
+	    "data\n");
+  }
+#endif
+
+  if ((ec = output_open(cmdopt, &strm, &fnam)) != 0) {
+    dump_free(&dump);
+    exit(ec);
+  }
+
+  /* The records are decoded by a session without a logger connection,
+     so that warnings are displayed as for the read command */
+  if ((sp = rtk_session_open(NULL)) == NULL) {
+    fprintf(stderr,"rtkgps: Error allocating memory\n");
+    free(fnam);
+    dump_free(&dump);
+    exit(2);
+  }
+  sp->gcwrnfp = warning;
+
+  /* Reset warning function message records */
+  warning(sp, NULL, 0, NULL);
+
+  /* Split requested range of log files from the image */
+  for (n = cmdopt->fnmn; n <= cmdopt->fnmx; n++) {
+    file_split(sp, &dump, n, fnam, strm, &gdht, cmdopt);
+
+    /* Reset warning function message records */
+    warning(sp, NULL, 0, NULL);
+  }
+
+  /* Free memory allocated for file name */
+  free(fnam);
+
+  dump_free(&dump);
+  rtk_session_close(sp);
+
+#ifdef GEOIDCOR
+   /* Destroy geoid correction data structure */
+  geoid_calc_close(&gdht);
+#endif
+}
+
+
+/*****************************************************************************
+ Get data progress callback function.
+ *****************************************************************************/
+void get_data_progress(rtk_session_t *sp UNUSED, int nfxt, int nfxc) {
+  text_progress_bar((float)nfxc/(float)nfxt, NULL);
+  if (nfxc == nfxt)
+    fprintf(stderr,"\n");
+}
+
+
+/*****************************************************************************
+ Get data completion callback function, which records received fixes
+ in the checkpoint of the log file being read, if there is one.
+ *****************************************************************************/
+void get_data_checkpoint(rtk_session_t *sp UNUSED, const gps_fix_t *gfxp,
+			 int fn0, int nfx) {
+  if (ckpt.fp == NULL || fn0 != ckpt.nfix)
+    return;
+  if (ckpt_append(&ckpt, gfxp, nfx) < 0) {
+    fprintf(stderr, "rtkgps: Warning: error writing checkpoint file %s "
+	    "[%s]\n", ckpt.path, strerror(errno));
+    ckpt_close(&ckpt, 0);
+  }
+}
+
+
+/*****************************************************************************
+ Get data completion callback function for a sweep of several log
+ files, which records received fixes in the checkpoint of the log file
+ to which they belong. The checkpoint of each log file is opened when
+ its first fix is received, which also gives the start time for its
+ file name, if not already known.
+ *****************************************************************************/
+void sweep_checkpoint(rtk_session_t *sp UNUSED, const gps_fix_t *gfxp,
+		      int fn0, int nfx) {
+  const logfile_t *lgfp;
+  char ckpp[1040];
+  int n, fn;
+
+  while (nfx > 0) {
+    /* Move on to the log file containing fix fn0 */
+    while (fn0 >= swp.fxb + swp.lgflp[swp.cur].nfix) {
+      ckpt_close(&ckpt, 0);
+      swp.fxb += swp.lgflp[swp.cur].nfix;
+      swp.cur++;
+    }
+    lgfp = swp.lgflp + swp.cur;
+    fn = fn0 - swp.fxb;
+
+    if (fn == 0) {
+      if (swp.timep[swp.cur][0] == '\0') {
+	sprintf(swp.timep[swp.cur], "%02d%02d%02d", gfxp->hour, gfxp->min,
+		gfxp->sec);
+	logcache_file_put(swp.lcp, swp.flnm + swp.cur, lgfp,
+			  swp.timep[swp.cur]);
+      }
+      output_file_name(swp.fnam, lgfp, swp.timep[swp.cur], 0, swp.cmdopt);
+      snprintf(ckpp, sizeof(ckpp), "%s.ckpt", swp.fnam);
+      if (ckpt_open(&ckpt, ckpp, lgfp, swp.gfxp + swp.fxb) < 0)
+	fprintf(stderr, "rtkgps: Warning: could not open checkpoint file %s "
+		"[%s]\n", ckpp, strerror(errno));
+    }
+
+    /* Append the fixes that the checkpoint does not already hold */
+    n = lgfp->nfix - fn;
+    if (n > nfx)
+      n = nfx;
+    if (ckpt.fp != NULL && fn <= ckpt.nfix && fn + n > ckpt.nfix &&
+	ckpt_append(&ckpt, gfxp + ckpt.nfix - fn, fn + n - ckpt.nfix) < 0) {
+      fprintf(stderr, "rtkgps: Warning: error writing checkpoint file %s "
+	      "[%s]\n", ckpt.path, strerror(errno));
+      ckpt_close(&ckpt, 0);
+    }
+    gfxp += n;
+    fn0 += n;
+    nfx -= n;
+  }
+}
+
+
+/*****************************************************************************
+ Get data raw records callback function for the dump command, which
+ writes the records to the memory image stream given by the session
+ callback data.
+ *****************************************************************************/
+void get_data_raw(rtk_session_t *sp, const char *rec, long int nbyt) {
+  fwrite(rec, 1, nbyt, (FILE *)sp->arg);
+}
+
+
+/*****************************************************************************
+ File metadata callback function, which prints the metadata for a
+ single file as a line of the file listing, and caches it in the
+ metadata cache pointed to by arg, if not NULL.
+ *****************************************************************************/
+void file_info_print(short int filen, const logfile_t *lgfp, void *arg) {
+  if (arg != NULL)
+    logcache_file_put(arg, filen, lgfp, NULL);
+  printf("%8d   %8s  %8hd  %7d  %7d\n", filen, lgfp->date, lgfp->fxtyp,
+	 lgfp->nfix, lgfp->memp);
+  fflush(stdout);
+}
+
+
+/*****************************************************************************
+ File metadata callback function, which adds the memory used by a
+ single file to the total in the file_size_sum_t pointed to by arg,
+ and caches the metadata.
+ *****************************************************************************/
+void file_info_size(short int filen, const logfile_t *lgfp, void *arg) {
+  file_size_sum_t *fssp = arg;
+
+  logcache_file_put(fssp->lcp, filen, lgfp, NULL);
+  fssp->mu += lgfp->nfix*fix_size(lgfp->fxtyp);
+}
+
+
+/*****************************************************************************
+ File metadata callback function, which stores the metadata for a
+ single file in the file_table_t pointed to by arg, and caches it.
+ *****************************************************************************/
+void file_info_store(short int filen, const logfile_t *lgfp, void *arg) {
+  file_table_t *ftp = arg;
+
+  logcache_file_put(ftp->lcp, filen, lgfp, NULL);
+  ftp->lgflp[filen] = *lgfp;
+}
+
+
+/*****************************************************************************
+ Open the log file metadata cache for the connected logger, after
+ checking that the log has not been erased or overwritten since it was
+ last used, from the log boundary and number of files. The log boundary
+ is read if lgbp is NULL. If the check fails, caching is disabled.
+ *****************************************************************************/
+void metadata_cache_open(rtk_session_t *sp, logcache_t *lcp,
+			 const log_bndry_t *lgbp, const status_t *status,
+			 const cmdlnopts_t *cmdopt) {
+  log_bndry_t lgbd;
+  const char *devid;
+
+  lcp->name[0] = '\0';
+  lcp->nfile = status->nfile;
+  devid = (cmdopt->btas != NULL)?cmdopt->btas:cmdopt->devs;
+  if (devid == NULL)
+    return;
+  if (lgbp == NULL) {
+    if (get_log_bndry(sp, &lgbd) < 0) {
+      if (cmdopt->vflg)
+	printf("Metadata cache disabled: failed to read log start/end "
+	       "details [%s]\n", gcstrerror(sp));
+      return;
+    }
+    lgbp = &lgbd;
+  }
+  if (logcache_open(lcp, devid, lgbp, status->nfile) < 0 && cmdopt->vflg)
+    printf("Metadata cache disabled: %s\n", strerror(errno));
+}
+
+
+/*****************************************************************************
+ Get metadata for log file filen into lgfp, from metadata cache lcp if
+ possible, or otherwise from the logger.
+ *****************************************************************************/
+int file_info(rtk_session_t *sp, const logcache_t *lcp, short int filen,
+	      logfile_t *lgfp) {
+  if (logcache_file_get(lcp, filen, lgfp, NULL) > 0)
+    return 1;
+  if (get_file_info(sp, filen, lgfp) < 0)
+    return -1;
+  logcache_file_put(lcp, filen, lgfp, NULL);
+
+  return 1;
+}
+
+
+/*****************************************************************************
+ Get metadata for log files fn0 to fn1 into the table ftp, together with
+ their start times if ftp->timep is not NULL. The metadata cache is
+ used for as many of the leading log files as possible, and the
+ metadata of the rest is requested with up to cmdopt->dwin requests
+ outstanding.
+ *****************************************************************************/
+int file_table(rtk_session_t *sp, file_table_t *ftp, short int fn0,
+	       short int fn1, const cmdlnopts_t *cmdopt) {
+  short int n;
+
+  for (n = fn0; n <= fn1 &&
+	 logcache_file_get(ftp->lcp, n, ftp->lgflp + n,
+			   (ftp->timep != NULL)?ftp->timep[n]:NULL); n++);
+  if (n > fn1)
+    return 0;
+  if (cmdopt->vflg)
+    printf("Requesting metadata for %d files\n", fn1 - n + 1);
+
+  return get_files_info(sp, n, fn1 - n + 1, cmdopt->dwin, file_info_store,
+			ftp);
+}
+
+
+/*****************************************************************************
+ Get logger memory details into memp, from metadata cache lcp if
+ possible, or otherwise from the logger.
+ *****************************************************************************/
+int memory_info(rtk_session_t *sp, const logcache_t *lcp, memory_t *memp) {
+  if (logcache_memory_get(lcp, memp) > 0)
+    return 1;
+  if (get_memory_info(sp, memp) < 0)
+    return -1;
+  logcache_memory_put(lcp, memp);
+
+  return 1;
+}
+
+
+/*****************************************************************************
+ Enable display of the text progress bar for log data retrieval, on
+ whichever of stdout or stderr is a terminal.
+ *****************************************************************************/
+void progress_bar_enable(rtk_session_t *sp) {
+#ifdef HAVE_TIOCGWINSZ
+  struct winsize ws;
+  if (ioctl(1, TIOCGWINSZ, (void *)&ws) == 0)
+    prgbrfp = 1;
+  else if (ioctl(2, TIOCGWINSZ, (void *)&ws) == 0)
+    prgbrfp = 2;
+#else
+  prgbrfp = 1;
+#endif
+  if (prgbrfp)
+    sp->gdpfp = get_data_progress;
+}
+
+
+/*****************************************************************************
+ Display text progress bar.
+ *****************************************************************************/
+void text_progress_bar(float frac, const char *prfs) {
+  static const char *prfx = "";
+  static unsigned short nbpv = 0;
+  static unsigned short ncol = 0;
+  static unsigned short bmax = 0;
+  static char bar[] = "================================================="
+    "==================================================================="
+    "===================================================================";
+  static char spc[] = "                                                 "
+    "                                                                   "
+    "                                                                   "
+    "                                                                   ";
+
+  if (prfs == NULL && prgbrfp) {
+    FILE *fp = NULL;
+    unsigned short nbar;
+
+    /* Set output file pointer based on file descriptor in prgbrfp */
+    if (prgbrfp == 1)
+      fp = stdout;
+    else if (prgbrfp == 2)
+      fp = stderr;
+    else
+      return;
+
+#ifdef HAVE_TIOCGWINSZ
+    {
+      struct winsize ws;
+      if (ioctl(prgbrfp, TIOCGWINSZ, (void *)&ws) == 0)
+        ncol = ws.ws_col;
+      else
+        return;
+    }
+#else
+    ncol = 40;
+#endif
+
+    if (frac < 0) {
+      /* Print spaces to clear current progress bar line */
+      fprintf(fp, "%.*s\r", (int)((ncol < strlen(spc))?ncol:strlen(spc)), spc);
+      fflush(fp);
+    } else {
+      /* Compute length of current progress bar */
+      bmax = ncol - strlen(prfx) - 7;
+      if (bmax > strlen(bar))
+	bmax = strlen(bar);
+      nbar = (unsigned short)floor(frac*bmax);
+      if (nbar > bmax)
+	nbar = bmax;
+
+      /* If progress bar length has changed, print new line and update
+	 previous bar length */
+      if (nbar != nbpv) {
+	nbpv = nbar;
+	fprintf(fp, "%s|%.*s%.*s| %3.0f%%\r", prfx, nbar, bar, bmax-nbar,
+		spc, 100.0*frac);
+	fflush(fp);
+      }
+    }
+  } else
+    prfx = prfs;
+}
+
+
+/*****************************************************************************
+ Warning display function.
+ *****************************************************************************/
+#if defined(__GNUC__) && !defined(DEBUG)
+void warning(rtk_session_t *sp UNUSED, const char *wrn,
+	     int line __attribute__((unused)),
+	     const char *file __attribute__((unused))) {
+#else
+void warning(rtk_session_t *sp UNUSED, const char *wrn, int line,
+	     const char *file) {
+#endif
+  static char wmsg[20][256];
+  static uint8_t nmsg = 0;
+
+  if (wrn == NULL) {
+    /* Reset warning message records if function called with null string */
+    nmsg = 0;
+  } else {
+    /* Record and print non-null string */
+    uint8_t msn = 0;
+    uint8_t n = 0;
+
+#ifdef DEBUG
+    /* When debugging, print every message */
+    msn = 1;
+#else
+    /* Determine whether error message has already been encountered */
+    for (n = 0; n < nmsg; n++) {
+      if (strncmp(wrn, wmsg[n], 255) == 0) {
+	msn = 1;
+	break;
+      }
+    }
+#endif
+
+    if (!msn) {
+      /* Current error message has not already been encountered */
+#ifndef DEBUG
+      /* When debugging, no need to record messages */
+      if (nmsg < 20) {
+	strncpy(wmsg[n], wrn, 255);
+	wmsg[n][255] = '\0';
+	nmsg++;
+      }
+#endif
+
+      /* If progress bar file descriptor is not zero, call progress bar
+	 function with request to clear current progress bar line. */
+      if (prgbrfp)
+	text_progress_bar(-1.0, NULL);
       /* Print warning */
       fprintf(stderr, "rtkgps: Warning: ");
       fprintf(stderr, "%s ", wrn);
@@ -961,91 +1578,177 @@ int file_backup(const char *path) {
 }
 
 
+/*****************************************************************************
+ Handle unspecified ends of the requested range of file numbers, and
+ restrict it to the nfile log files available. Returns -1 if none of
+ the requested file numbers are valid.
+ *****************************************************************************/
+int file_range(cmdlnopts_t *cmdopt, short int nfile) {
+  if (cmdopt->fnmn == -1)
+    cmdopt->fnmn = 0;
+  if (cmdopt->fnmx == -1)
+    cmdopt->fnmx = nfile-1;
+
+  /* Check for minimum file number out of range */
+  if (cmdopt->fnmn >= nfile) {
+    fprintf(stderr,"rtkgps: Requested file number(s) all invalid\n");
+    return -1;
+  }
+
+  /* Check for maximum file number out of range */
+  if (cmdopt->fnmx >= nfile) {
+    cmdopt->fnmx = nfile-1;
+    fprintf(stderr, "rtkgps:  Warning: reduced maximum requested file "
+	    "number to valid range\n");
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Open the output for log files, returning 0, or an exit status on
+ failure. The complicated handling of output files, split between this
+ function and file_read or file_split, is due to the following output
+ policy:
+  • If no output file is specified, selected logfiles are written
+    to stdout
+  • If the specified output file is a regular file, all selected logfiles
+    are written to that file
+  • If the specified output file is a directory, each selected logfile is
+    written to a unique file within that directory
+ In the last case, *strmp is set to NULL, and memory for constructing
+ the full output file names is allocated at *fnamp.
+ *****************************************************************************/
+int output_open(const cmdlnopts_t *cmdopt, FILE **strmp, char **fnamp) {
+  *strmp = NULL;
+  *fnamp = NULL;
+  if (cmdopt->dsts == NULL)
+    *strmp = stdout; /* If output flag not specified, output is stdout */
+  else {
+    /* If output flag is specified, determine whether it is a directory */
+    if (is_directory(cmdopt->dsts)) {
+      /* If specified output path is a directory, allocate memory for
+	 constructing the full output filename */
+      if ((*fnamp = malloc(strlen(cmdopt->dsts) + 32)) == NULL) {
+	fprintf(stderr,"rtkgps: Error allocating memory\n");
+	return 2;
+      }
+    } else {
+      /* If specified output path is not a directory, open the file
+	 for writing after creating a backup if the file already exists. */
+      if (file_backup(cmdopt->dsts) != 0) {
+	fprintf(stderr,"rtkgps: Error creating backup of file %s\n",
+		cmdopt->dsts);
+	return 3;
+      }
+      if ((*strmp = fopen(cmdopt->dsts, "w")) == NULL) {
+	fprintf(stderr,"rtkgps: Error opening output file %s [%s]\n",
+		cmdopt->dsts, strerror(errno));
+	return 3;
+      }
+    }
+  }
+
+  if (*strmp != NULL) {
+    /* Write output file header */
+    if (cmdopt->nflg)
+      print_hdr_native(*strmp);
+    else
+      print_hdr_nmea(*strmp, cmdopt->btas);
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Construct the standard path, within output directory cmdopt->dsts, of
+ the output file for log file lgfp, with first fix at time time, in
+ fnam. The name of the file of a log file that is still being
+ captured has a postfix, selected by part, to indicate that it is not
+ complete.
+ *****************************************************************************/
+#if defined(FILENAME_DATE_PTR)
+void output_file_name(char *fnam, const logfile_t *lgfp,
+		      const char *time __attribute__((unused)), int part,
+		      const cmdlnopts_t *cmdopt) {
+  sprintf(fnam, "%s/%8.8s_%06x%s.%s", cmdopt->dsts, lgfp->date,
+	  lgfp->memp, (part)?"_part":"", (cmdopt->nflg)?"rngl":"nmea");
+}
+#else
+void output_file_name(char *fnam, const logfile_t *lgfp, const char *time,
+		      int part, const cmdlnopts_t *cmdopt) {
+  sprintf(fnam, "%s/%8.8sT%6.6sZ%s.%s", cmdopt->dsts, lgfp->date,
+	  time, (part)?"_part":"", (cmdopt->nflg)?"rngl":"nmea");
+}
+#endif
+
+
 /*****************************************************************************
  Open communications with GPS device.
  *****************************************************************************/
-int coms_open(cmdlnopts_t *cmdopt) {
-  int fd = -1;
+rtk_session_t *coms_open(cmdlnopts_t *cmdopt) {
+  transport_t *tp = NULL;
+  rtk_session_t *sp;
+  int dtct = 0;
 
   /* Open communication with device */
   if (cmdopt->devs != NULL) {
-    /* Serial device name is provided */
-    fd = dev_open(cmdopt->devs);
-    if (fd < 0) {
+    /* Device name is provided: select the transport from its prefix */
+    const transport_ops_t *ops;
+    const char *addrs;
+
+    ops = transport_lookup(cmdopt->devs, &addrs);
+    tp = transport_open(ops, addrs, cmdopt->sspd);
+    if (tp == NULL) {
       fprintf(stderr, "rtkgps: Error opening device %s [%s]\n", cmdopt->devs,
 	      strerror(errno));
       exit(4);
     }
-    if (dev_config_serial(fd, cmdopt->sspd) < 0) {
-      fprintf(stderr, "rtkgps: Error setting device speed to %u [%s]\n",
-      		cmdopt->sspd, strerror(errno));
-      exit(4);
-    }
+    /* Detect the line speed of a serial device if not specified */
+    dtct = (ops == &serial_transport && cmdopt->spds == NULL);
 
     /* Display connection message in verbose mode */
     if (cmdopt->vflg) {
-      printf("Opened device %s at %u baud\n", cmdopt->devs, cmdopt->sspd);
+      if (ops == &serial_transport && !dtct)
+	printf("Opened device %s at %u baud\n", cmdopt->devs, cmdopt->sspd);
+      else
+	printf("Opened device %s\n", cmdopt->devs);
     }
   } else {
 #if ENABLE_LINUX_BT-0
     static char btscs[24];
+    char val[32];
+    int scnd = 0;
+
     /* Serial device name not provide: scan or use provide bluetooth address */
     if (cmdopt->btas == NULL) {
-      /* Bluetooth address not specified: do a scan for a matching device */
-      bt_device_t btd[32];
-      int nbtd, nbgp = -1, n;
-
-      /* Perform scan */
-      nbtd = bt_scan(btd, 32);
-      if (nbtd < 0) {
-	fprintf(stderr, "rtkgps: Error perfoming bluetooth scan [%s]\n",
-		strerror(errno));
-	exit(4);
+      /* Bluetooth address not specified: first try a direct connection
+	 to the device found by the most recent scan, since a scan takes
+	 more than 10s */
+      if (cache_get("bluetooth", "BlueGPS", val, sizeof(val)) > 0 &&
+	  sscanf(val, "%23s", btscs) == 1) {
+	if (cmdopt->vflg)
+	  printf("Trying previously found device %s\n", btscs);
+	/* The cached device is forgotten if it cannot be connected to,
+	   so that the connection is not attempted again should the
+	   scan also fail */
+	if ((tp = bt_connect(btscs, 1)) == NULL &&
+	    cache_clear("bluetooth") < 0 && cmdopt->vflg)
+	  printf("Failed to clear cached bluetooth device [%s]\n",
+		 strerror(errno));
       }
-      /* Report error if no devices found */
-      if (nbtd == 0) {
-	fprintf(stderr, "rtkgps: No bluetooth devices found during scan\n");
-	exit(4);
-      }
-      /* Display scan result in verbose mode */
-      if (cmdopt->vflg) {
-	printf("Bluetooth scan:\n");
-	bt_scan_print(stdout,  btd, nbtd);
-      }
-      /* Look for single bluetooth device named BlueGPS */
-      for (n = 0; n < nbtd; n++) {
-	if (strncmp(btd[n].name, "BlueGPS ", 8) == 0) {
-	  if (nbgp == -1)
-	    nbgp = n;
-	  else {
-	    /* Report error if multiple matching devices found */
-	    fprintf(stderr, "rtkgps: Multiple BlueGPS devices found during"
-		    " scan\n");
-	    exit(4);
-	  }
-	}
-      }
-      if (nbgp == -1) {
-	/* Report error if no matching devices found */
-	fprintf(stderr, "rtkgps: No BlueGPS devices found during scan\n");
-	exit(4);
+      /* Do a scan for a matching device if there is no cached device or
+	 it could not be connected to */
+      if (tp == NULL) {
+	bt_scan_select(btscs, cmdopt);
+	scnd = 1;
       }
-      /* Set selected device address from matching device address */
-      ba2str(&btd[nbgp].bdaddr, btscs);
-
       cmdopt->btas = btscs;
-      /* Display matching device details in verbose mode */
-      if (cmdopt->vflg) {
-	printf("Found appropriate device: ");
-	bt_scan_print(stdout,  &btd[nbgp], 1);
-      }
-      /* This delay avoids "Operation already in progress" errors on
-	 trying to open the bluetooth connection */
-      sleep(1);
     }
     /* Open a connection to the selected bluetooth device */
-    fd = bt_open(cmdopt->btas, 1);
-    if (fd < 0) {
+    if (tp == NULL && (tp = bt_connect(cmdopt->btas, 6)) == NULL) {
       fprintf(stderr, "rtkgps: Error connecting to %s [%s]\n", cmdopt->btas,
 	      strerror(errno));
       exit(4);
@@ -1054,24 +1757,195 @@ int coms_open(cmdlnopts_t *cmdopt) {
     if (cmdopt->vflg) {
       printf("Connected to %s\n", cmdopt->btas);
     }
+    /* Record the device found by the scan for subsequent connections */
+    if (scnd) {
+      if (cache_put("bluetooth", "BlueGPS", btscs) < 0 && cmdopt->vflg)
+	printf("Failed to cache bluetooth device [%s]\n", strerror(errno));
+    }
 #endif /* ENABLE_LINUX_BT */
   }
 
-  return fd;
+  /* Inject faults into device input if requested. This is done
+     before capture, so that a trace records the faulty input. */
+  if (cmdopt->flts != NULL) {
+    transport_t *ftp;
+
+    if ((ftp = fault_inject(tp, cmdopt->flts)) == NULL) {
+      fprintf(stderr, "rtkgps: Invalid fault injection profile %s\n",
+	      cmdopt->flts);
+      transport_close(tp);
+      exit(1);
+    }
+    tp = ftp;
+  }
+
+  /* Record device traffic if requested */
+  if (cmdopt->caps != NULL) {
+    transport_t *ctp;
+
+    if ((ctp = trace_capture(tp, cmdopt->caps)) == NULL) {
+      fprintf(stderr, "rtkgps: Error opening capture file %s [%s]\n",
+	      cmdopt->caps, strerror(errno));
+      transport_close(tp);
+      exit(4);
+    }
+    tp = ctp;
+    if (cmdopt->vflg)
+      printf("Capturing device traffic to %s\n", cmdopt->caps);
+  }
+
+  /* Set up the protocol session, with warnings passed to the warning
+     display function */
+  if ((sp = rtk_session_open(tp)) == NULL) {
+    fprintf(stderr, "rtkgps: Error allocating memory\n");
+    transport_close(tp);
+    exit(2);
+  }
+  sp->gcwrnfp = warning;
+
+  if (dtct)
+    line_speed_detect(sp, cmdopt);
+
+  return sp;
+}
+
+
+/*****************************************************************************
+ Detect the line speed of the logger, trying the speed cached for the
+ device, if any, first.
+ *****************************************************************************/
+void line_speed_detect(rtk_session_t *sp, cmdlnopts_t *cmdopt) {
+  static const unsigned int spdc[] = {57600, 115200, 38400, 19200, 9600,
+				      4800};
+  unsigned int spdl[8];
+  unsigned int cspd = 0;
+  char val[16];
+  int nspd = 0, n;
+
+  if (cache_get("speed", cmdopt->devs, val, sizeof(val)) > 0 &&
+      sscanf(val, "%u", &cspd) == 1 && dev_speed_valid(cspd))
+    spdl[nspd++] = cspd;
+  for (n = 0; n < (int)(sizeof(spdc)/sizeof(spdc[0])); n++) {
+    if (spdc[n] != cspd)
+      spdl[nspd++] = spdc[n];
+  }
+
+  if ((n = detect_line_speed(sp, spdl, nspd, 300)) < 0) {
+    fprintf(stderr, "rtkgps: Warning: failed to detect line speed [%s]\n",
+	    gcstrerror(sp));
+    transport_speed(sp->tp, cmdopt->sspd);
+    return;
+  }
+  cmdopt->sspd = spdl[n];
+  if (cmdopt->vflg)
+    printf("Detected line speed of %u baud\n", cmdopt->sspd);
+
+  /* Record the detected speed for the next connection to the device */
+  if (cmdopt->sspd != cspd) {
+    sprintf(val, "%u", cmdopt->sspd);
+    if (cache_put("speed", cmdopt->devs, val) < 0 && cmdopt->vflg)
+      printf("Failed to cache line speed [%s]\n", strerror(errno));
+  }
+}
+
+
+#if ENABLE_LINUX_BT-0
+/*****************************************************************************
+ Perform a bluetooth scan for a single device named BlueGPS, and copy
+ its address into btas.
+ *****************************************************************************/
+void bt_scan_select(char *btas, const cmdlnopts_t *cmdopt) {
+  bt_device_t btd[32];
+  int nbtd, nbgp = -1, n;
+
+  /* Perform scan */
+  nbtd = bt_scan(btd, 32);
+  if (nbtd < 0) {
+    fprintf(stderr, "rtkgps: Error perfoming bluetooth scan [%s]\n",
+	    strerror(errno));
+    exit(4);
+  }
+  /* Report error if no devices found */
+  if (nbtd == 0) {
+    fprintf(stderr, "rtkgps: No bluetooth devices found during scan\n");
+    exit(4);
+  }
+  /* Display scan result in verbose mode */
+  if (cmdopt->vflg) {
+    printf("Bluetooth scan:\n");
+    bt_scan_print(stdout,  btd, nbtd);
+  }
+  /* Look for single bluetooth device named BlueGPS */
+  for (n = 0; n < nbtd; n++) {
+    if (strncmp(btd[n].name, "BlueGPS ", 8) == 0) {
+      if (nbgp == -1)
+	nbgp = n;
+      else {
+	/* Report error if multiple matching devices found */
+	fprintf(stderr, "rtkgps: Multiple BlueGPS devices found during"
+		" scan\n");
+	exit(4);
+      }
+    }
+  }
+  if (nbgp == -1) {
+    /* Report error if no matching devices found */
+    fprintf(stderr, "rtkgps: No BlueGPS devices found during scan\n");
+    exit(4);
+  }
+  /* Set selected device address from matching device address */
+  ba2str(&btd[nbgp].bdaddr, btas);
+
+  /* Display matching device details in verbose mode */
+  if (cmdopt->vflg) {
+    printf("Found appropriate device: ");
+    bt_scan_print(stdout,  &btd[nbgp], 1);
+  }
+}
+
+
+/*****************************************************************************
+ Open a connection to bluetooth address btas, making at most ntry
+ attempts. Returns NULL, with errno set, on failure.
+ *****************************************************************************/
+transport_t *bt_connect(const char *btas, int ntry) {
+  struct timespec dl;
+  transport_t *tp;
+  long int dly = 100;
+  int n;
+
+  for (n = 1; (tp = transport_open(&rfcomm_transport, btas, 1)) == NULL;
+       n++) {
+    /* Connecting shortly after a scan may fail with "Operation already
+       in progress", so such transient errors are retried after
+       exponentially increasing delays. Other errors, such as the
+       device not responding, are not retried. */
+    if (n >= ntry || (errno != EALREADY && errno != EINPROGRESS &&
+		      errno != EBUSY && errno != EAGAIN))
+      return NULL;
+    deadline_set(&dl, dly);
+    deadline_sleep(&dl);
+    dly *= 2;
+  }
+
+  return tp;
 }
+#endif /* ENABLE_LINUX_BT */
 
 
 /*****************************************************************************
  Close communications with GPS device.
  *****************************************************************************/
-void coms_close(int fd, const cmdlnopts_t *cmdopt) {
-  if (cmdopt->devs != NULL) {
-    dev_close(fd);
-    if (cmdopt->vflg)
+void coms_close(rtk_session_t *sp, const cmdlnopts_t *cmdopt) {
+  /* Ensure that the logger is not left at the data transfer speed */
+  xfer_speed_restore(sp, cmdopt);
+  if (cmdopt->flts != NULL)
+    fault_stats_print(stderr, sp->tp);
+  rtk_session_close(sp);
+  if (cmdopt->vflg) {
+    if (cmdopt->devs != NULL)
       printf("Closed device %s\n", cmdopt->devs);
-  } else {
-    bt_close(fd);
-    if (cmdopt->vflg)
+    else
       printf("Disconnected from %s\n", cmdopt->btas);
   }
 }
@@ -1080,15 +1954,15 @@ void coms_close(int fd, const cmdlnopts_t *cmdopt) {
 /*****************************************************************************
  Disable GPS mouse mode (1Hz real-time NMEA output).
  *****************************************************************************/
-void gpsmouse_disable(int fd, int md, const cmdlnopts_t *cmdopt) {
+void gpsmouse_disable(rtk_session_t *sp, int md, const cmdlnopts_t *cmdopt) {
   /* Set GPS mouse mode inactive */
   if (md) {
     if (cmdopt->vflg)
       printf("Disabling GPS mouse mode\n");
-    if (set_mode(fd, 1, 0) < 0) {
+    if (set_mode(sp, 1, 0) < 0) {
       fprintf(stderr,"rtkgps: Failed to set logger mode [%s]\n",
-	      gcstrerror(rcerrno));
-      coms_close(fd, cmdopt);
+	      gcstrerror(sp));
+      coms_close(sp, cmdopt);
       exit(5);
     }
   }
@@ -1098,15 +1972,15 @@ void gpsmouse_disable(int fd, int md, const cmdlnopts_t *cmdopt) {
 /*****************************************************************************
  Enable GPS mouse mode (1Hz real-time NMEA output).
  *****************************************************************************/
-void gpsmouse_enable(int fd, int md, const cmdlnopts_t *cmdopt) {
+void gpsmouse_enable(rtk_session_t *sp, int md, const cmdlnopts_t *cmdopt) {
  /* Restore GPS mouse mode if appropriate */
   if (md) {
     if (cmdopt->vflg)
       printf("Enabling GPS mouse mode\n");
-    if (set_mode(fd, 1, 1) < 0) {
+    if (set_mode(sp, 1, 1) < 0) {
       fprintf(stderr,"rtkgps: Failed to set logger mode [%s]\n",
-	      gcstrerror(rcerrno));
-      coms_close(fd, cmdopt);
+	      gcstrerror(sp));
+      coms_close(sp, cmdopt);
       exit(5);
     }
   }
@@ -1116,14 +1990,14 @@ void gpsmouse_enable(int fd, int md, const cmdlnopts_t *cmdopt) {
 /*****************************************************************************
  Disable logger and GPS mouse mode (1Hz real-time NMEA output).
  *****************************************************************************/
-void outlog_disable(int fd, const cmdlnopts_t *cmdopt) {
+void outlog_disable(rtk_session_t *sp, const cmdlnopts_t *cmdopt) {
   /* Set logger and GPS mouse mode inactive */
   if (cmdopt->vflg)
     printf("Disabling logger and GPS mouse mode\n");
-  if (set_mode(fd, 0, 0) < 0) {
+  if (set_mode(sp, 0, 0) < 0) {
     fprintf(stderr,"rtkgps: Failed to set logger mode [%s]\n",
-	    gcstrerror(rcerrno));
-    coms_close(fd, cmdopt);
+	    gcstrerror(sp));
+    coms_close(sp, cmdopt);
     exit(5);
   }
 }
@@ -1132,7 +2006,7 @@ void outlog_disable(int fd, const cmdlnopts_t *cmdopt) {
 /*****************************************************************************
  Enable logger and GPS mouse mode (1Hz real-time NMEA output).
  *****************************************************************************/
-void outlog_enable(int fd, int md, const cmdlnopts_t *cmdopt) {
+void outlog_enable(rtk_session_t *sp, int md, const cmdlnopts_t *cmdopt) {
   /* Restore logger and GPS mouse mode */
   if (cmdopt->vflg) {
     if (md)
@@ -1140,23 +2014,75 @@ void outlog_enable(int fd, int md, const cmdlnopts_t *cmdopt) {
     else
       printf("Enabling logger\n");
   }
-  if (set_mode(fd, 1, md) < 0) {
+  if (set_mode(sp, 1, md) < 0) {
     fprintf(stderr,"rtkgps: Failed to set logger mode [%s]\n",
-	    gcstrerror(rcerrno));
-    coms_close(fd, cmdopt);
+	    gcstrerror(sp));
+    coms_close(sp, cmdopt);
     exit(5);
   }
 }
 
 
+/*****************************************************************************
+ Switch logger and serial device to the data transfer line speed.
+ *****************************************************************************/
+void xfer_speed_enable(rtk_session_t *sp, const cmdlnopts_t *cmdopt) {
+  if (cmdopt->xspd == 0)
+    return;
+  if (cmdopt->vflg)
+    printf("Switching to %u baud for data transfer\n", cmdopt->xspd);
+  xfrspd = cmdopt->xspd;
+  if (set_line_speed(sp, cmdopt->xspd) < 0) {
+    fprintf(stderr, "rtkgps: Warning: failed to switch to %u baud [%s]\n",
+	    cmdopt->xspd, gcstrerror(sp));
+    xfer_speed_restore(sp, cmdopt);
+  }
+}
+
+
+/*****************************************************************************
+ Restore logger and serial device to the original line speed after a
+ switch to the data transfer line speed.
+ *****************************************************************************/
+void xfer_speed_restore(rtk_session_t *sp, const cmdlnopts_t *cmdopt) {
+  char rsp[256];
+
+  if (xfrspd == 0)
+    return;
+  xfrspd = 0;
+  if (cmdopt->vflg)
+    printf("Restoring %u baud\n", cmdopt->sspd);
+  if (set_line_speed(sp, cmdopt->sspd) < 0) {
+    /* The logger may not have switched speed, in which case it
+       responds at the original speed */
+    if (transport_speed(sp->tp, cmdopt->sspd) < 0 ||
+	get_cmd_response(sp, "$PROY108*", "$LOG108", rsp, 256) == NULL)
+      fprintf(stderr, "rtkgps: Warning: failed to restore %u baud [%s]\n",
+	      cmdopt->sspd, gcstrerror(sp));
+  }
+}
+
+
+/*****************************************************************************
+ Report the number of log data requests that had to be repeated, and
+ of duplicated sentences discarded, during transfer xfp.
+ *****************************************************************************/
+void xfer_report(const xfer_t *xfp, const cmdlnopts_t *cmdopt) {
+  if (cmdopt->vflg && (xfp->nrtry > 0 || xfp->ndup > 0))
+    printf("Repeated %d data requests, discarded %d duplicate sentences\n",
+	   xfp->nrtry, xfp->ndup);
+}
+
+
 /*****************************************************************************
  Read GPS device status.
  *****************************************************************************/
-void status_read(int fd, status_t *status, const cmdlnopts_t *cmdopt) {
-  if (get_status(fd, status) < 0) {
+void status_read(rtk_session_t *sp, status_t *status,
+		 const cmdlnopts_t *cmdopt) {
+  if (get_status(sp, status) < 0) {
     fprintf(stderr,"rtkgps: Failed to get device status [%s]\n",
-	    gcstrerror(rcerrno));
-    coms_close(fd, cmdopt);
+	    gcstrerror(sp));
+    coms_close(sp, cmdopt);
     exit(5);
   }
 }
@@ -1165,30 +2091,20 @@ void status_read(int fd, status_t *status, const cmdlnopts_t *cmdopt) {
 /*****************************************************************************
  Read a single log file.
  *****************************************************************************/
-void file_read(int fd, short int flnm, char *fnam, FILE *strm,
-	       const geoid_height_t *gdhtp, const status_t* status,
+void file_read(rtk_session_t *sp, short int flnm, const file_table_t *ftp,
+	       char *fnam, FILE *strm, const geoid_height_t *gdhtp,
+	       const status_t* status, xfer_t *xfp,
 	       const cmdlnopts_t *cmdopt) {
-  logfile_t lgfl;
+  logfile_t lgfl = ftp->lgflp[flnm];
+  char *time = ftp->timep[flnm];
 #if !defined(FILENAME_DATE_PTR)
   date_time_t dt;
 #endif
   gps_fix_t *gfxp = NULL;
   float *gcrp = NULL;
-  char *pstr = "";
-  int fn;
-
-  if (cmdopt->vflg)
-    printf("Requesting metadata for file %4d\n", flnm);
-
-  /* Read metadata for file number flnm */
-  if (get_file_info(fd, flnm, &lgfl) < 0) {
-    fprintf(stderr,"rtkgps: Error reading information for file %d [%s]\n",
-	    flnm, gcstrerror(rcerrno));
-    free(fnam);
-    outlog_enable(fd, status->gpsms, cmdopt);
-    coms_close(fd, cmdopt);
-    exit(5);
-  }
+  char ckpp[1040] = "", pckpp[1040] = "";
+  int fn, fn0 = 0, nsnc = 0;
+  short int snflg = 0;
 
   /* If memory is allocated for the file name, the output path is a
       destination directory. Construct a standard file path with the
@@ -1196,28 +2112,33 @@ void file_read(int fd, short int flnm, char *fnam, FILE *strm,
   if (fnam != NULL) {
 
 #if !defined(FILENAME_DATE_PTR)
-    if (get_file_start_time(fd, &lgfl, &dt) != 1) {
-      fprintf(stderr,"rtkgps: Error reading initial time for file %d [%s]\n",
-	      flnm, gcstrerror(rcerrno));
-      free(fnam);
-      outlog_enable(fd, status->gpsms, cmdopt);
-      coms_close(fd, cmdopt);
-      exit(5);
+    /* The start time is requested if it was not in the metadata cache */
+    if (time[0] == '\0') {
+      if (get_file_start_time(sp, &lgfl, &dt) != 1) {
+	fprintf(stderr,"rtkgps: Error reading initial time for file %d "
+		"[%s]\n", flnm, gcstrerror(sp));
+	free(fnam);
+	outlog_enable(sp, status->gpsms, cmdopt);
+	coms_close(sp, cmdopt);
+	exit(5);
+      }
+      strcpy(time, dt.time);
+      logcache_file_put(ftp->lcp, flnm, &lgfl, time);
     }
 #endif
 
-    /* Add filename postfix to indicate file is not complete (data
-       still being captured). */
-    if (flnm == status->nfile-1)
-      pstr = "_part";
-    /* Construct file name */
-#if defined(FILENAME_DATE_PTR)
-    sprintf(fnam, "%s/%8.8s_%06x%s.%s", cmdopt->dsts, lgfl.date, 
-	    lgfl.memp, pstr, (cmdopt->nflg)?"rngl":"nmea");
-#else
-    sprintf(fnam, "%s/%8.8sT%6.6sZ%s.%s", cmdopt->dsts, lgfl.date, 
-	    dt.time, pstr, (cmdopt->nflg)?"rngl":"nmea");
-#endif
+    /* Construct the name of the file while the log file is still being
+       captured, with a postfix to indicate that it is not complete */
+    output_file_name(fnam, &lgfl, time, 1, cmdopt);
+    snprintf(ckpp, sizeof(ckpp), "%s.ckpt", fnam);
+
+    /* Construct file name, which is as above for the last log file */
+    if (flnm != status->nfile-1) {
+      strcpy(pckpp, ckpp);
+      output_file_name(fnam, &lgfl, time, 0, cmdopt);
+      snprintf(ckpp, sizeof(ckpp), "%s.ckpt", fnam);
+    }
+
     /* Skip existing files if requested */
     if (cmdopt->uflg && is_nzsregfile(fnam) && flnm != status->nfile-1) {
       if (cmdopt->vflg)
@@ -1225,21 +2146,36 @@ void file_read(int fd, short int flnm, char *fnam, FILE *strm,
       return;
     }
 
+    /* A log file that was being captured when last read has a
+       checkpoint under its incomplete name, which is moved so that
+       only fixes logged since then need to be retrieved */
+    if (pckpp[0] != '\0' && access(pckpp, F_OK) == 0 &&
+	access(ckpp, F_OK) != 0)
+      rename(pckpp, ckpp);
+
+    /* The output file of the log file being captured is extended,
+       rather than replaced, if requested and its checkpoint records
+       the fixes that it already holds. This is not possible for the
+       native format, which has the number of fixes in its header. */
+    snflg = (cmdopt->uflg && flnm == status->nfile-1);
+    if (snflg && !cmdopt->nflg && is_nzsregfile(fnam))
+      nsnc = ckpt_synced(ckpp, &lgfl);
+
     /* Create backup of output file if it already exists */
-    if (file_backup(fnam) != 0) {
+    if (nsnc == 0 && file_backup(fnam) != 0) {
       fprintf(stderr,"rtkgps: Error creating backup of file %s\n", fnam);
       free(fnam);
-      outlog_enable(fd, status->gpsms, cmdopt);
-      coms_close(fd, cmdopt);
+      outlog_enable(sp, status->gpsms, cmdopt);
+      coms_close(sp, cmdopt);
       exit(3);
     }
     /* Attempt to open file */
-    if ((strm = fopen(fnam, "w")) == NULL) {
+    if ((strm = fopen(fnam, (nsnc > 0)?"a":"w")) == NULL) {
       fprintf(stderr,"rtkgps: Error opening output file %s [%s]\n",
-	      fnam, gcstrerror(rcerrno));
+	      fnam, gcstrerror(sp));
       free(fnam);
-      outlog_enable(fd, status->gpsms, cmdopt);
-      coms_close(fd, cmdopt);
+      outlog_enable(sp, status->gpsms, cmdopt);
+      coms_close(sp, cmdopt);
       exit(3);
     }
   }
@@ -1250,8 +2186,8 @@ void file_read(int fd, short int flnm, char *fnam, FILE *strm,
     free(fnam);
     if (fnam != NULL)
       fclose(strm);
-    outlog_enable(fd, status->gpsms, cmdopt);
-    coms_close(fd, cmdopt);
+    outlog_enable(sp, status->gpsms, cmdopt);
+    coms_close(sp, cmdopt);
     exit(2);
   }
 
@@ -1263,21 +2199,38 @@ void file_read(int fd, short int flnm, char *fnam, FILE *strm,
       free(fnam);
       if (fnam != NULL)
 	fclose(strm);
-      outlog_enable(fd, status->gpsms, cmdopt);
-      coms_close(fd, cmdopt);
+      outlog_enable(sp, status->gpsms, cmdopt);
+      coms_close(sp, cmdopt);
       exit(2);
     }
   }
 #endif
 
+  /* If the output path is a directory, record the fixes received in a
+     checkpoint file alongside the output file, and resume from the
+     checkpoint left by an earlier, interrupted read of the same log
+     file if there is one */
+  if (fnam != NULL) {
+    if ((fn0 = ckpt_open(&ckpt, ckpp, &lgfl, gfxp)) < 0) {
+      fprintf(stderr, "rtkgps: Warning: could not open checkpoint file %s "
+	      "[%s]\n", ckpp, strerror(errno));
+      fn0 = 0;
+    } else if (fn0 > 0 && cmdopt->vflg)
+      printf("Resuming file %4d from fix %d\n", flnm, fn0);
+  }
+
   if (cmdopt->vflg)
     printf("Requesting content of file   %4d\n", flnm);
 
   /* Read the log file data */
-  fn = get_file_data(fd, &lgfl, gfxp);
+  fn = get_file_data(sp, &lgfl, gfxp, fn0, xfp);
   if (fn < 0) {
     fprintf(stderr,"rtkgps: Error reading file %d [%s]\n",
-	    flnm, gcstrerror(rcerrno));
+	    flnm, gcstrerror(sp));
+    if (ckpt.nfix > 0)
+      fprintf(stderr,"rtkgps: %d of %d fixes saved in checkpoint file %s\n",
+	      ckpt.nfix, lgfl.nfix, ckpt.path);
+    ckpt_close(&ckpt, 0);
     /* Remove empty file so that it isn't skipped (with -u flag) on
        read restart */
     if (fnam != NULL)
@@ -1287,24 +2240,16 @@ void file_read(int fd, short int flnm, char *fnam, FILE *strm,
     free(fnam);
     if (fnam != NULL)
       fclose(strm);
-    outlog_enable(fd, status->gpsms, cmdopt);
-    coms_close(fd, cmdopt);
+    outlog_enable(sp, status->gpsms, cmdopt);
+    coms_close(sp, cmdopt);
     exit(5);
   }
 
-#ifdef GEOIDCOR
   if (gcrp != NULL) {
-    const double dgrd = 360.0/(2*M_PI);
-    unsigned short n;
-
     if (cmdopt->vflg)
       printf("Computing geoid altitude corrections\n");
-    for (n = 0; n < lgfl.nfix; n++) {
-      gcrp[n] = geoid_calc_correction(gdhtp, dgrd*gfxp[n].lat,
-				      dgrd*gfxp[n].lng);
-    }
+    geoid_correct(gdhtp, &lgfl, gfxp, gcrp);
   }
-#endif
 
   /* Print the log file data to the output stream */
   if (cmdopt->nflg) {
@@ -1313,9 +2258,17 @@ void file_read(int fd, short int flnm, char *fnam, FILE *strm,
     print_log_native(strm, &lgfl, gfxp, gcrp);
   }
   else {
-    if (fnam != NULL)
+    logfile_t nwlf = lgfl;
+
+    /* Only the fixes not already in the output file are written. The
+       checkpoint records that the output file is being modified, so
+       that it is replaced by the next read if writing is interrupted. */
+    if (snflg && ckpt.fp != NULL)
+      ckpt_sync(&ckpt, 0);
+    if (fnam != NULL && nsnc == 0)
       print_hdr_nmea(strm, cmdopt->btas);
-    print_log_nmea(strm, &lgfl, gfxp, gcrp);
+    nwlf.nfix -= nsnc;
+    print_log_nmea(strm, &nwlf, gfxp + nsnc, (gcrp != NULL)?gcrp+nsnc:NULL);
   }
 
   /* Free memory for geoid correction values */
@@ -1325,7 +2278,330 @@ void file_read(int fd, short int flnm, char *fnam, FILE *strm,
 
   /* If memory is allocated for the file name, the output path is a
      directory and the output stream was opened in this function, so
-     the stream should be closed here */
+     the stream should be closed here. The checkpoint is no longer
+     needed once the output file has been written, except for that of
+     the log file being captured when its output file is to be
+     extended, which then records that all fixes have been written. */
+  if (fnam != NULL) {
+    if (fflush(strm) == 0 && !ferror(strm) && snflg && ckpt.fp != NULL &&
+	fsync(fileno(strm)) == 0 && ckpt_sync(&ckpt, lgfl.nfix) == 0)
+      ckpt_close(&ckpt, 0);
+    else
+      ckpt_close(&ckpt, !ferror(strm));
+    fclose(strm);
+  }
+}
+
+
+/*****************************************************************************
+ Return the number of log files, from file number flnm up to fnmx, to
+ be retrieved by a single sweep of logger memory. These are complete
+ log files that follow each other in logger memory, and have the same
+ record type. The log file being captured, log files to be skipped
+ with the -u flag, and log files with a checkpoint left by an earlier
+ read are retrieved individually, as are empty log files.
+ *****************************************************************************/
+#if defined(FILENAME_DATE_PTR)
+short int sweep_select(rtk_session_t *sp __attribute__((unused)),
+		       const file_table_t *ftp, short int flnm,
+		       short int fnmx, char *fnam, const status_t *status,
+		       const cmdlnopts_t *cmdopt) {
+#else
+short int sweep_select(rtk_session_t *sp, const file_table_t *ftp,
+		       short int flnm, short int fnmx, char *fnam,
+		       const status_t *status, const cmdlnopts_t *cmdopt) {
+  date_time_t dt;
+#endif
+  char ckpp[1040];
+  short int n;
+
+  if (fnmx >= status->nfile-1)
+    fnmx = status->nfile-2;
+  for (n = flnm; n <= fnmx; n++) {
+    const logfile_t *lgfp = ftp->lgflp + n;
+    char *time = ftp->timep[n];
+
+    if (lgfp->nfix == 0 ||
+	(n > flnm && files_contiguous(lgfp - 1, 2) < 2))
+      break;
+    if (fnam == NULL)
+      continue;
+
+#if !defined(FILENAME_DATE_PTR)
+    /* Whether the output file exists can only be determined from its
+       name, which requires the start time. Otherwise, the start time
+       is taken from the first fix received. */
+    if (time[0] == '\0' && cmdopt->uflg) {
+      if (get_file_start_time(sp, lgfp, &dt) != 1)
+	break;
+      strcpy(time, dt.time);
+      logcache_file_put(ftp->lcp, n, lgfp, time);
+    }
+    /* A log file with a checkpoint has a cached start time, as it was
+       recorded when the checkpoint was created */
+    if (time[0] == '\0')
+      continue;
+#endif
+    output_file_name(fnam, lgfp, time, 0, cmdopt);
+    snprintf(ckpp, sizeof(ckpp), "%s.ckpt", fnam);
+    if ((cmdopt->uflg && is_nzsregfile(fnam)) || access(ckpp, F_OK) == 0)
+      break;
+    output_file_name(fnam, lgfp, time, 1, cmdopt);
+    snprintf(ckpp, sizeof(ckpp), "%s.ckpt", fnam);
+    if (access(ckpp, F_OK) == 0)
+      break;
+  }
+
+  return n - flnm;
+}
+
+
+/*****************************************************************************
+ Read nfile log files, from file number flnm, as a single sweep of
+ logger memory, with data requests crossing the boundaries between log
+ files. The fixes are then separated into the log files to which they
+ belong, which are written as in file_read.
+ *****************************************************************************/
+void sweep_read(rtk_session_t *sp, const file_table_t *ftp, short int flnm,
+		short int nfile, char *fnam, FILE *strm,
+		const geoid_height_t *gdhtp, const status_t* status,
+		xfer_t *xfp, const cmdlnopts_t *cmdopt) {
+  const logfile_t *lgflp = ftp->lgflp + flnm;
+  gps_fix_t *gfxp = NULL;
+  float *gcrp = NULL;
+  char ckpp[1040], nstr[16];
+  int fxb, nfx = 0;
+  short int n;
+
+  for (n = 0; n < nfile; n++)
+    nfx += lgflp[n].nfix;
+
+  /* If progress bar requested and verbose output not enabled, set up
+     prefix displaying file number range */
+  if (cmdopt->pflg && !cmdopt->vflg) {
+    sprintf(nstr, "%4d-%d ", flnm, flnm + nfile - 1);
+    text_progress_bar(0.0, nstr);
+  }
+
+  /* Allocate memory for the log file data, and for geoid correction
+     values if necessary */
+  if ((gfxp = malloc(nfx*sizeof(gps_fix_t))) == NULL) {
+    fprintf(stderr,"rtkgps: Error allocating memory\n");
+    free(fnam);
+    outlog_enable(sp, status->gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(2);
+  }
+#ifdef GEOIDCOR
+  if (lgflp->fxtyp > 0 && gdhtp->filep != NULL) {
+    if ((gcrp = malloc(nfx*sizeof(float))) == NULL) {
+      fprintf(stderr,"rtkgps: Error allocating memory\n");
+      free(gfxp);
+      free(fnam);
+      outlog_enable(sp, status->gpsms, cmdopt);
+      coms_close(sp, cmdopt);
+      exit(2);
+    }
+  }
+#endif
+
+  /* If the output path is a directory, record the fixes received in
+     the checkpoint of the log file to which they belong */
+  if (fnam != NULL) {
+    swp.lgflp = lgflp;
+    swp.timep = ftp->timep + flnm;
+    swp.gfxp = gfxp;
+    swp.flnm = flnm;
+    swp.cur = 0;
+    swp.fxb = 0;
+    swp.fnam = fnam;
+    swp.lcp = ftp->lcp;
+    swp.cmdopt = cmdopt;
+    sp->gdcfp = sweep_checkpoint;
+  } else
+    sp->gdcfp = NULL;
+
+  if (cmdopt->vflg)
+    printf("Requesting content of files  %4d-%d\n", flnm, flnm + nfile - 1);
+
+  /* Read the log file data */
+  fxb = get_files_data(sp, lgflp, nfile, gfxp, xfp);
+  sp->gdcfp = get_data_checkpoint;
+  if (fxb < 0) {
+    fprintf(stderr,"rtkgps: Error reading files %d-%d [%s]\n",
+	    flnm, flnm + nfile - 1, gcstrerror(sp));
+    if (ckpt.nfix > 0)
+      fprintf(stderr,"rtkgps: %d of %d fixes saved in checkpoint file %s\n",
+	      ckpt.nfix, lgflp[swp.cur].nfix, ckpt.path);
+    ckpt_close(&ckpt, 0);
+    free(gcrp);
+    free(gfxp);
+    free(fnam);
+    outlog_enable(sp, status->gpsms, cmdopt);
+    coms_close(sp, cmdopt);
+    exit(5);
+  }
+  ckpt_close(&ckpt, 0);
+
+  if (gcrp != NULL) {
+    if (cmdopt->vflg)
+      printf("Computing geoid altitude corrections\n");
+    for (n = 0, fxb = 0; n < nfile; fxb += lgflp[n].nfix, n++)
+      geoid_correct(gdhtp, lgflp + n, gfxp + fxb, gcrp + fxb);
+  }
+
+  /* Write each log file to the output stream, or to its own file if
+     the output path is a directory, in which case its checkpoint is
+     no longer needed once it has been written */
+  for (n = 0, fxb = 0; n < nfile; fxb += lgflp[n].nfix, n++) {
+    if (fnam != NULL) {
+      output_file_name(fnam, lgflp + n, ftp->timep[flnm + n], 0, cmdopt);
+      snprintf(ckpp, sizeof(ckpp), "%s.ckpt", fnam);
+      if (file_backup(fnam) != 0) {
+	fprintf(stderr,"rtkgps: Error creating backup of file %s\n", fnam);
+	free(gcrp);
+	free(gfxp);
+	free(fnam);
+	outlog_enable(sp, status->gpsms, cmdopt);
+	coms_close(sp, cmdopt);
+	exit(3);
+      }
+      if ((strm = fopen(fnam, "w")) == NULL) {
+	fprintf(stderr,"rtkgps: Error opening output file %s [%s]\n",
+		fnam, strerror(errno));
+	free(gcrp);
+	free(gfxp);
+	free(fnam);
+	outlog_enable(sp, status->gpsms, cmdopt);
+	coms_close(sp, cmdopt);
+	exit(3);
+      }
+    }
+    log_write(strm, lgflp + n, gfxp + fxb, (gcrp != NULL)?gcrp + fxb:NULL,
+	      fnam != NULL, cmdopt);
+    if (fnam != NULL) {
+      if (fflush(strm) == 0 && !ferror(strm))
+	remove(ckpp);
+      fclose(strm);
+    }
+  }
+
+  free(gcrp);
+  free(gfxp);
+}
+
+
+/*****************************************************************************
+ Write fixes gfxp of log file lgfp, with geoid corrections gcrp if not
+ NULL, to stream strm in the selected output format, preceded by the
+ output file header if hdr is non-zero.
+ *****************************************************************************/
+void log_write(FILE *strm, const logfile_t *lgfp, const gps_fix_t *gfxp,
+	       const float *gcrp, int hdr, const cmdlnopts_t *cmdopt) {
+  if (cmdopt->nflg) {
+    if (hdr)
+      print_hdr_native(strm);
+    print_log_native(strm, lgfp, gfxp, gcrp);
+  } else {
+    if (hdr)
+      print_hdr_nmea(strm, cmdopt->btas);
+    print_log_nmea(strm, lgfp, gfxp, gcrp);
+  }
+}
+
+
+/*****************************************************************************
+ Split a single log file from memory image dp.
+ *****************************************************************************/
+void file_split(rtk_session_t *sp, const dump_t *dp, short int flnm,
+		char *fnam, FILE *strm, const geoid_height_t *gdhtp,
+		const cmdlnopts_t *cmdopt) {
+  const logfile_t *lgfp = dp->lgflp + flnm;
+  gps_fix_t *gfxp = NULL;
+  float *gcrp = NULL;
+  char time[7] = "000000";
+
+  if (cmdopt->vflg)
+    printf("Decoding file %4d\n", flnm);
+
+  /* Allocate memory for the log file data, and decode it */
+  if ((gfxp = malloc((lgfp->nfix+1)*sizeof(gps_fix_t))) == NULL) {
+    fprintf(stderr,"rtkgps: Error allocating memory\n");
+    free(fnam);
+    exit(2);
+  }
+  dump_file_fixes(sp, dp, flnm, gfxp);
+
+  /* If memory is allocated for the file name, the output path is a
+     destination directory. Construct a standard file path with the
+     directory as a base, and open the file for writing */
+  if (fnam != NULL) {
+    if (lgfp->nfix > 0)
+      snprintf(time, sizeof(time), "%02u%02u%02u", gfxp[0].hour % 24u,
+	       gfxp[0].min % 60u, gfxp[0].sec % 60u);
+    output_file_name(fnam, lgfp, time, flnm == dp->nfile-1, cmdopt);
+
+    /* Create backup of output file if it already exists */
+    if (file_backup(fnam) != 0) {
+      fprintf(stderr,"rtkgps: Error creating backup of file %s\n", fnam);
+      free(gfxp);
+      free(fnam);
+      exit(3);
+    }
+    /* Attempt to open file */
+    if ((strm = fopen(fnam, "w")) == NULL) {
+      fprintf(stderr,"rtkgps: Error opening output file %s [%s]\n",
+	      fnam, strerror(errno));
+      free(gfxp);
+      free(fnam);
+      exit(3);
+    }
+  }
+
+#ifdef GEOIDCOR
+  /* If necessary, compute geoid correction values */
+  if (lgfp->fxtyp > 0 && gdhtp->filep != NULL) {
+    if ((gcrp = malloc((lgfp->nfix+1)*sizeof(float))) == NULL) {
+      fprintf(stderr,"rtkgps: Error allocating memory\n");
+      free(gfxp);
+      free(fnam);
+      exit(2);
+    }
+    geoid_correct(gdhtp, lgfp, gfxp, gcrp);
+  }
+#endif
+
+  /* Print the log file data to the output stream */
+  log_write(strm, lgfp, gfxp, gcrp, fnam != NULL, cmdopt);
+
+  free(gcrp);
+  free(gfxp);
+
+  /* If memory is allocated for the file name, the output stream was
+     opened in this function, and should be closed here */
   if (fnam != NULL)
     fclose(strm);
 }
+
+
+/*****************************************************************************
+ Compute geoid altitude corrections gcrp for fixes gfxp of log file
+ lgfp.
+ *****************************************************************************/
+#ifdef GEOIDCOR
+void geoid_correct(const geoid_height_t *gdhtp, const logfile_t *lgfp,
+		   const gps_fix_t *gfxp, float *gcrp) {
+  const double dgrd = 360.0/(2*M_PI);
+  int n;
+
+  for (n = 0; n < lgfp->nfix; n++)
+    gcrp[n] = geoid_calc_correction(gdhtp, dgrd*gfxp[n].lat,
+				    dgrd*gfxp[n].lng);
+}
+#else
+void geoid_correct(const geoid_height_t *gdhtp __attribute__((unused)),
+		   const logfile_t *lgfp __attribute__((unused)),
+		   const gps_fix_t *gfxp __attribute__((unused)),
+		   float *gcrp __attribute__((unused))) {
+}
+#endif
@@ -11,7 +11,7 @@
     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
     General Public License for more details.
 
-    Most recent modification: 30 May 2009
+    Most recent modification: 17 October 2026
 
 ******************************************************************************/
 
@@ -42,9 +42,6 @@ static void cfmakeraw(struct termios *tiosp) {
 }
 #endif
 
-static struct termios origopt;
-
-
 #if ENABLE_LINUX_BT-0
 /*****************************************************************************
  Scan for bluetooth devices, inserting a maximum of mndv entries into btdp.
@@ -182,6 +179,18 @@ static speed_t get_speed(unsigned int speed) {
     return B57600;
   case 115200:
     return B115200;
+#ifdef B230400
+  case 230400:
+    return B230400;
+#endif
+#ifdef B460800
+  case 460800:
+    return B460800;
+#endif
+#ifdef B921600
+  case 921600:
+    return B921600;
+#endif
   }
   return 0; /* invalid */
 }
@@ -195,16 +204,22 @@ int dev_speed_valid(unsigned int speed) {
 
 /*****************************************************************************
  Sets the speed of a serial connection and configures the connection.
+ A speed of zero leaves the line speed unchanged (e.g. for a
+ pseudo-terminal). On failure, the connection is closed, restoring
+ the terminal settings tiosp saved when it was opened.
  *****************************************************************************/
-int dev_config_serial(int fd, unsigned int speed) {
+int dev_config_serial(int fd, unsigned int speed,
+		      const struct termios *tiosp) {
   struct termios termopt;
   speed_t spd;
   /* initialize with current values (for cygwin) */
   tcgetattr(fd, &termopt);
 
-  spd = get_speed(speed);
-  cfsetispeed(&termopt, spd);
-  cfsetospeed(&termopt, spd);
+  if (speed != 0) {
+    spd = get_speed(speed);
+    cfsetispeed(&termopt, spd);
+    cfsetospeed(&termopt, spd);
+  }
 
   cfmakeraw(&termopt);
 
@@ -212,12 +227,12 @@ int dev_config_serial(int fd, unsigned int speed) {
   termopt.c_cc[VTIME] = 0;
 
   if (tcsetattr(fd, TCSANOW, &termopt) < 0) {
-    dev_close(fd);
+    dev_close(fd, tiosp);
     return -1;
   }
 
   if (tcflush(fd, TCIFLUSH) < 0) {
-    dev_close(fd);
+    dev_close(fd, tiosp);
     return -1;
   }
 
@@ -225,170 +240,412 @@ int dev_config_serial(int fd, unsigned int speed) {
 }
 
 /*****************************************************************************
- Open a serial connection to device devs.
+ Change the line speed of an open serial connection, after waiting
+ for all pending output to be transmitted.
+ *****************************************************************************/
+int dev_set_speed(int fd, unsigned int speed) {
+  struct termios termopt;
+  speed_t spd;
+
+  if ((spd = get_speed(speed)) == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (tcdrain(fd) < 0 || tcgetattr(fd, &termopt) < 0)
+    return -1;
+  cfsetispeed(&termopt, spd);
+  cfsetospeed(&termopt, spd);
+
+  return tcsetattr(fd, TCSADRAIN, &termopt);
+}
+
+
+/*****************************************************************************
+ Set the number of bytes of input that must be available before a
+ poll on serial connection fd reports input. Reads are non-blocking,
+ so that this only affects waiting: with VTIME zero, the terminal
+ driver does not wake a poll until VMIN bytes have been received.
+ *****************************************************************************/
+int dev_set_watermark(int fd, unsigned int n) {
+  struct termios termopt;
+
+  if (tcgetattr(fd, &termopt) < 0)
+    return -1;
+  termopt.c_cc[VMIN]  = n;
+  termopt.c_cc[VTIME] = 0;
+
+  return tcsetattr(fd, TCSANOW, &termopt);
+}
+
+
+/*****************************************************************************
+ Open a serial connection to device devs, saving its terminal settings
+ in tiosp.
  *****************************************************************************/
-int dev_open(const char *devs) {
+int dev_open(const char *devs, struct termios *tiosp) {
  int fd;
 
   fd = open(devs, O_RDWR | O_NOCTTY | O_NONBLOCK);
   if (fd != -1) {
-    tcgetattr(fd, &origopt);
+    tcgetattr(fd, tiosp);
   }
   return fd;
 }
 
 
 /*****************************************************************************
- Close a serial connection and return the device to its pre-connection state.
+ Close a serial connection and return the device to its pre-connection
+ state, given by the terminal settings tiosp saved when it was opened.
  *****************************************************************************/
-int dev_close(int fd) {
-  tcsetattr(fd, TCSANOW, &origopt);
+int dev_close(int fd, const struct termios *tiosp) {
+  tcsetattr(fd, TCSANOW, tiosp);
   return close(fd);
 }
 
 
 /*****************************************************************************
- Read at most bsz bytes from file descriptor fd into buffer buf.
+ Set deadline dlp to tmt milliseconds from the current time.
+ *****************************************************************************/
+void deadline_set(struct timespec *dlp, long int tmt) {
+  clock_gettime(DEADLINE_CLOCK, dlp);
+  dlp->tv_sec += tmt / 1000;
+  dlp->tv_nsec += (tmt % 1000) * 1000000L;
+  if (dlp->tv_nsec >= 1000000000L) {
+    dlp->tv_sec++;
+    dlp->tv_nsec -= 1000000000L;
+  }
+}
+
+
+/*****************************************************************************
+ Return the number of milliseconds, rounded up, until deadline dlp
+ expires, or zero if it has already expired.
+ *****************************************************************************/
+long int deadline_remaining(const struct timespec *dlp) {
+  struct timespec now;
+  long int ms;
+
+  clock_gettime(DEADLINE_CLOCK, &now);
+  ms = (dlp->tv_sec - now.tv_sec) * 1000L +
+    (dlp->tv_nsec - now.tv_nsec + 999999L) / 1000000L;
+
+  return (ms > 0)?ms:0;
+}
+
+
+/*****************************************************************************
+ Return the number of microseconds elapsed since time tsp, as set by
+ deadline_set with a timeout of zero.
+ *****************************************************************************/
+long int deadline_elapsed(const struct timespec *tsp) {
+  struct timespec now;
+
+  clock_gettime(DEADLINE_CLOCK, &now);
+  return (now.tv_sec - tsp->tv_sec) * 1000000L +
+    (now.tv_nsec - tsp->tv_nsec) / 1000L;
+}
+
+
+/*****************************************************************************
+ Sleep until deadline dlp expires.
+ *****************************************************************************/
+void deadline_sleep(const struct timespec *dlp) {
+  while (clock_nanosleep(DEADLINE_CLOCK, TIMER_ABSTIME, dlp, NULL) == EINTR)
+    ;
+}
+
+
+/*****************************************************************************
+ Read at most bsz bytes from transport tp into buffer buf, waiting no
+ later than deadline dlp for input.
+ *****************************************************************************/
+ssize_t serial_read(transport_t *tp, char *buf, size_t bsz,
+		    const struct timespec *dlp) {
+  ssize_t b;
+  int wt;
+
+  /* Try to read before waiting: while a response is being streamed
+     input is usually already available, and the wait call can be
+     avoided. This is not done when an input watermark is set, since a
+     read of fewer bytes would leave the watermark exceeding the input
+     still to come. */
+  if (tp->rxwm <= 1 && (b = tp->ops->read(tp, buf, bsz)) != 0)
+    return b;
+
+  /* Wait for input, returning a read count of zero on timeout and -1
+     on error. A wrapping transport may hold back input reported by
+     the transport that it wraps, so the wait is repeated if nothing
+     could be read before the deadline. */
+  do {
+    if ((wt = tp->ops->wait(tp, dlp)) <= 0)
+      return wt;
+    b = tp->ops->read(tp, buf, bsz);
+  } while (b == 0 && !tp->eof && deadline_remaining(dlp) > 0);
+
+  return b;
+}
+
+
+/*****************************************************************************
+ Write bsz bytes from buffer buf to transport tp.
+ *****************************************************************************/
+ssize_t serial_write(transport_t *tp, const char *buf, size_t bsz) {
+  return tp->ops->write(tp, buf, bsz);
+}
+
+
+/*****************************************************************************
+ Find the first occurrence of the sl byte string str in the bsz bytes of
+ buf. Returns NULL if not found. No assumptions are made with respect
+ to string termination, so that binary content may be searched.
+ *****************************************************************************/
+static const char *find_bytes(const char *buf, size_t bsz, const char *str,
+			      size_t sl) {
+  const char *p = buf, *e = buf + bsz;
+
+  if (sl == 0)
+    return buf;
+  while ((size_t)(e - p) >= sl) {
+    /* Use memchr to skip quickly to the next candidate first byte */
+    if ((p = memchr(p, str[0], e - p - sl + 1)) == NULL)
+      return NULL;
+    if (memcmp(p, str, sl) == 0)
+      return p;
+    p++;
+  }
+
+  return NULL;
+}
+
+
+/*****************************************************************************
+ Return the number of unconsumed bytes in the input buffer of tp.
+ *****************************************************************************/
+size_t serial_buffered(const transport_t *tp) {
+  return tp->ibwp - tp->ibrp;
+}
+
+
+/*****************************************************************************
+ Return a pointer to the first unconsumed byte in the input buffer of
+ tp. The pointer is invalidated by any subsequent read from tp.
+ *****************************************************************************/
+char *serial_peek(transport_t *tp) {
+  return tp->ibuf + tp->ibrp;
+}
+
+
+/*****************************************************************************
+ Consume (discard) n bytes from the start of the input buffer of tp.
+ *****************************************************************************/
+void serial_consume(transport_t *tp, size_t n) {
+  if (n >= tp->ibwp - tp->ibrp)
+    tp->ibrp = tp->ibwp = 0;
+  else
+    tp->ibrp += n;
+}
+
+
+/*****************************************************************************
+ Ensure that there is free space at the end of the input buffer of tp.
+ *****************************************************************************/
+static int ibuf_reserve(transport_t *tp) {
+  /* Unconsumed bytes are only moved to the start of the buffer when
+     the free space at the end becomes small, so that in the usual
+     case of consuming complete sentences, no copying is required. */
+  if (tp->ibrp > 0 && TRANSPORT_IBSZ - tp->ibwp < TRANSPORT_IBSZ/4) {
+    memmove(tp->ibuf, tp->ibuf + tp->ibrp, tp->ibwp - tp->ibrp);
+    tp->ibwp -= tp->ibrp;
+    tp->ibrp = 0;
+  }
+  if (tp->ibwp == TRANSPORT_IBSZ) {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Set the input watermark of tp to the number of bytes of expected
+ input still to be received, up to the largest supported watermark.
+ *****************************************************************************/
+static int rx_watermark(transport_t *tp) {
+  return transport_watermark(tp, (tp->rxexp < TRANSPORT_MXWM)?
+			     tp->rxexp:TRANSPORT_MXWM);
+}
+
+
+/*****************************************************************************
+ Record that b bytes have been appended to the input buffer of tp.
+ *****************************************************************************/
+static void rx_received(transport_t *tp, size_t b) {
+  tp->ibwp += b;
+  tp->rxexp = (b < tp->rxexp)?tp->rxexp - b:0;
+}
+
+
+/*****************************************************************************
+ Declare that at least n bytes of input, beyond those already
+ buffered, are expected from tp. Until they have been received, waits
+ for input do not return until as many of them as the transport
+ allows are available, so that a long response is received in a few
+ large reads rather than in many small ones. A count of zero cancels
+ the expectation. The count must not exceed the input actually sent,
+ since otherwise the final wait only returns at its deadline.
  *****************************************************************************/
-ssize_t serial_read(int fd, char *buf, size_t bsz, long int tmt) {
+int serial_expect(transport_t *tp, size_t n) {
+  tp->rxexp = n;
+  return rx_watermark(tp);
+}
+
+
+/*****************************************************************************
+ Append input from tp to its input buffer. Returns the number of bytes
+ added, zero on timeout, and -1 on error.
+ *****************************************************************************/
+ssize_t serial_fill(transport_t *tp, const struct timespec *dlp) {
   ssize_t b;
-  struct timeval tv = {0,100};
-  fd_set rfds;
-  int slct;
-
-  /* Set up and call select to wait for input on fd */
-  FD_ZERO(&rfds);
-  FD_SET(fd, &rfds);
-  tv.tv_usec = tmt % 1000;
-  tv.tv_sec = tmt / 1000;
-  slct = select(fd+1, &rfds, NULL, NULL, &tv);
-  /* Return -1 on select error */
-  if (slct == -1)
+
+  if (ibuf_reserve(tp) < 0)
     return -1;
 
-  /* Return read count of zero if select timed out */
-  if (!slct)
-    return 0;
-  /* Read at most bsz bytes from fd */
-  b = read(fd, buf, bsz);
+  if (rx_watermark(tp) < 0)
+    return -1;
 
-  /* If read returns -1 but errno is EAGAIN, set read count to zero */
-  if (b < 0 && errno == EAGAIN)
-    b = 0;
+  b = serial_read(tp, tp->ibuf + tp->ibwp, TRANSPORT_IBSZ - tp->ibwp, dlp);
+  if (b > 0)
+    rx_received(tp, b);
+  else if (b == 0 && tp->rxexp > 0) {
+    /* Input stopped short of the expected count, so return to
+       reporting each byte of input */
+    serial_expect(tp, 0);
+  }
 
   return b;
 }
 
 
 /*****************************************************************************
- Write bsz bytes from buffer buf to from file descriptor fd.
+ Append any input already available from tp to its input buffer,
+ without waiting. Returns the number of bytes added, or -1 on error.
  *****************************************************************************/
-ssize_t serial_write(int fd, const char *buf, size_t bsz) {
-  return write(fd, buf, bsz);
+ssize_t serial_drain(transport_t *tp) {
+  ssize_t b;
+
+  if (ibuf_reserve(tp) < 0)
+    return -1;
+
+  b = tp->ops->read(tp, tp->ibuf + tp->ibwp, TRANSPORT_IBSZ - tp->ibwp);
+  if (b > 0)
+    rx_received(tp, b);
+
+  return b;
 }
 
 
 /*****************************************************************************
- Repeat reading from fd until timeout expires or bsz bytes read.
+ Read from tp until at least n bytes are buffered. Returns the number
+ of buffered bytes, zero if deadline dlp expires first, and -1 on error.
  *****************************************************************************/
-ssize_t serial_read_repeat(int fd, char *buf, size_t bsz, long int tmt) {
-  size_t n = 0;
-  size_t m = bsz;
+ssize_t serial_read_count(transport_t *tp, size_t n,
+			  const struct timespec *dlp) {
   ssize_t b;
 
-  do {
-    b = serial_read(fd, buf + n, m, tmt);
-    if (b < 0)
-      return -1;
-    m -= b;
-    n += b;
-  } while (b > 0 && n < bsz);
+  while (serial_buffered(tp) < n) {
+    b = serial_fill(tp, dlp);
+    if (b <= 0)
+      return b;
+  }
+
+  return serial_buffered(tp);
+}
+
+
+/*****************************************************************************
+ Repeat reading from tp until deadline dlp expires or bsz bytes read,
+ copying the bytes read into buffer buf.
+ *****************************************************************************/
+ssize_t serial_read_repeat(transport_t *tp, char *buf, size_t bsz,
+			   const struct timespec *dlp) {
+  size_t n;
+
+  if (serial_read_count(tp, bsz, dlp) < 0)
+    return -1;
+  if ((n = serial_buffered(tp)) > bsz)
+    n = bsz;
+  memcpy(buf, serial_peek(tp), n);
+  serial_consume(tp, n);
 
   return n;
 }
 
 
 /*****************************************************************************
- Read from file descriptor fd, discarding input until string str is
- encountered.
+ Read from transport tp, discarding input until string str is at the
+ start of the input buffer. Returns the number of buffered bytes, zero
+ if deadline dlp expires first, and -1 on error.
  *****************************************************************************/
-ssize_t serial_read_discard(int fd, char *buf, size_t bsz, size_t pos,
-			    const char *str, long int tmt) {
-  char *s = NULL;
-  size_t n = pos;
-  size_t m = bsz-1-n;
-  size_t sl;
+ssize_t serial_read_discard(transport_t *tp, const char *str,
+			    const struct timespec *dlp) {
+  const char *s;
+  size_t sl, n;
   ssize_t b;
 
   sl = strlen(str);
-  buf[pos] = '\0';
-
-  while ((s = strstr(buf, str)) == NULL) {
-    /* If buffer contains more characters than sl (the length of str),
-       copy the last sl characters to the start of the buffer and set
-       buffer counters. */
-    if (n > sl) {
-      memmove(buf, buf + n - sl, sl);
-      n = sl;
-      m = bsz - 1 - n;
-    }
-
-    b = serial_read(fd, buf + n, m, tmt);
-    if (b < 0)
-      return -1;
-    if (b == 0)
-      return 0;
 
-    /* Insert end of string marker into buffer */
-    buf[n + b] = '\0';
-    m -= b;
-    n += b;
+  while ((s = find_bytes(serial_peek(tp), (n = serial_buffered(tp)),
+			 str, sl)) == NULL) {
+    /* Discard all but the last sl-1 bytes, which may be the start of
+       a match, so that each byte is only searched once or twice */
+    if (n >= sl)
+      serial_consume(tp, n - sl + 1);
+
+    b = serial_fill(tp, dlp);
+    if (b <= 0)
+      return b;
   }
 
-  n -= (s - buf);
-  memmove(buf, s, n+1); /* Move n+1 to include end of string marker */
+  serial_consume(tp, s - serial_peek(tp));
 
-  return n;
+  return serial_buffered(tp);
 }
 
 
 /*****************************************************************************
- Read from file descriptor fd, recording at most bsz bytes into buffer buf
- from when string bgn is read, and ending when string end is read.
+ Read from transport tp, discarding input until string bgn is at the
+ start of the input buffer, and then reading until string end is
+ buffered. Returns the length of the string from the start of bgn to
+ the end of end, or zero if no such string of length at most mxl is
+ received before deadline dlp. The string is not consumed.
  *****************************************************************************/
-ssize_t serial_read_string(int fd, char *buf, size_t bsz, size_t pos,
-			   const char *bgn, const char *end, long int tmt) {
-  char *s = NULL;
-  size_t n = pos;
-  size_t m = bsz-1;
+ssize_t serial_read_string(transport_t *tp, const char *bgn, const char *end,
+			   size_t mxl, const struct timespec *dlp) {
+  const char *s;
+  size_t el, n, m;
   ssize_t b;
 
-  b = serial_read_discard(fd, buf, bsz, n, bgn, tmt);
-  if (b < 0)
-    return -1;
-  if (b == 0)
-    return 0;
-  n = b;
-  m = bsz-1-n;
-
-  /* Read until timeout or string end encountered */
-  while (n < bsz && (s = strstr(buf, end)) == NULL) {
-    b = serial_read(fd, buf + n, m, tmt);
-    if (b < 0)
-      return -1;
-    if (b == 0) {
+  b = serial_read_discard(tp, bgn, dlp);
+  if (b <= 0)
+    return b;
+
+  /* Read until timeout or string end encountered, only searching
+     bytes that have not already been searched */
+  el = strlen(end);
+  m = strlen(bgn);
+  while ((s = find_bytes(serial_peek(tp) + m, (n = serial_buffered(tp)) - m,
+			 end, el)) == NULL) {
+    if (n >= mxl)
       return 0;
-    }
-    /* Set buffer counters */
-    m -= b;
-    n += b;
+    if (n - m >= el)
+      m = n - el + 1;
 
-    buf[n] = '\0';
+    b = serial_fill(tp, dlp);
+    if (b <= 0)
+      return b;
   }
 
-  /* Number of bytes read is zero if end string not encountered */
-  if (s == NULL)
-    n = 0;
-
-  return n;
+  n = s + el - serial_peek(tp);
+  return (n <= mxl)?(ssize_t)n:0;
 }
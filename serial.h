@@ -11,7 +11,7 @@
     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
     General Public License for more details.
 
-    Most recent modification: 29 May 2009
+    Most recent modification: 17 October 2026
 
 ******************************************************************************/
 
@@ -20,6 +20,8 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <time.h>
+#include "transport.h"
 #if ENABLE_LINUX_BT-0
 #include <bluetooth/bluetooth.h>
 
@@ -37,17 +39,42 @@ int bt_open(const char *addrs, unsigned short chn);
 int bt_close(int sck);
 
 int dev_speed_valid(unsigned int speed);
-int dev_open(const char *devs);
-int dev_config_serial(int fd, unsigned int speed);
-int dev_close(int fd);
-
-ssize_t serial_read(int fd, char *buf, size_t bsz, long int tmt);
-ssize_t serial_write(int fd, const char *buf, size_t bsz);
-
-ssize_t serial_read_repeat(int fd, char *buf, size_t bsz, long int tmt);
-ssize_t serial_read_discard(int fd, char *buf, size_t bsz, size_t pos,
-			    const char *str, long int tmt);
-ssize_t serial_read_string(int fd, char *buf, size_t bsz,  size_t pos,
-			   const char *bgn, const char *end, long int tmt);
+int dev_open(const char *devs, struct termios *tiosp);
+int dev_config_serial(int fd, unsigned int speed,
+		      const struct termios *tiosp);
+int dev_set_speed(int fd, unsigned int speed);
+int dev_set_watermark(int fd, unsigned int n);
+int dev_close(int fd, const struct termios *tiosp);
+
+#ifdef CLOCK_MONOTONIC
+#define DEADLINE_CLOCK CLOCK_MONOTONIC
+#else
+#define DEADLINE_CLOCK CLOCK_REALTIME
+#endif
+
+void deadline_set(struct timespec *dlp, long int tmt);
+long int deadline_remaining(const struct timespec *dlp);
+void deadline_sleep(const struct timespec *dlp);
+long int deadline_elapsed(const struct timespec *tsp);
+
+ssize_t serial_read(transport_t *tp, char *buf, size_t bsz,
+		    const struct timespec *dlp);
+ssize_t serial_write(transport_t *tp, const char *buf, size_t bsz);
+
+size_t serial_buffered(const transport_t *tp);
+char *serial_peek(transport_t *tp);
+void serial_consume(transport_t *tp, size_t n);
+ssize_t serial_fill(transport_t *tp, const struct timespec *dlp);
+ssize_t serial_drain(transport_t *tp);
+int serial_expect(transport_t *tp, size_t n);
+
+ssize_t serial_read_count(transport_t *tp, size_t n,
+			  const struct timespec *dlp);
+ssize_t serial_read_repeat(transport_t *tp, char *buf, size_t bsz,
+			   const struct timespec *dlp);
+ssize_t serial_read_discard(transport_t *tp, const char *str,
+			    const struct timespec *dlp);
+ssize_t serial_read_string(transport_t *tp, const char *bgn, const char *end,
+			   size_t mxl, const struct timespec *dlp);
 
 #endif
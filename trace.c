@@ -0,0 +1,419 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include "serial.h"
+#include "trace.h"
+
+
+typedef struct {
+  FILE *fp;             /* trace file */
+  struct timespec last; /* time of previous record */
+} capture_t;
+
+typedef struct {
+  unsigned char *trc;   /* trace file contents */
+  size_t tsz;           /* trace file size */
+  size_t tpos;          /* position of next record */
+  const char *rdp;      /* pending read data */
+  size_t rdn;           /* number of pending read bytes */
+  unsigned long nwp;    /* number of writes by program */
+  unsigned long nwt;    /* number of write records passed */
+  struct timespec wrtm; /* time of most recent write by program */
+  struct timespec due;  /* time at which pending read data is available */
+  short int fast;       /* ignore recorded timing */
+} replay_t;
+
+
+/*****************************************************************************
+ Append a record for bsz bytes of data buf transferred in direction
+ dir to the capture trace file. Data exceeding the maximum record
+ length are split across records with zero time difference.
+ *****************************************************************************/
+static int capture_record(capture_t *cp, int dir, const char *buf,
+			  size_t bsz) {
+  struct timespec now;
+  unsigned char hdr[TRACE_HDSZ];
+  unsigned long dt;
+  size_t n;
+
+  clock_gettime(DEADLINE_CLOCK, &now);
+  if (now.tv_sec - cp->last.tv_sec > 4000)
+    dt = 0xffffffffUL;
+  else
+    dt = (now.tv_sec - cp->last.tv_sec)*1000000L +
+      (now.tv_nsec - cp->last.tv_nsec)/1000;
+  cp->last = now;
+
+  do {
+    n = (bsz > 0xffff)?0xffff:bsz;
+    hdr[0] = dir;
+    hdr[1] = dt & 0xff;
+    hdr[2] = (dt >> 8) & 0xff;
+    hdr[3] = (dt >> 16) & 0xff;
+    hdr[4] = (dt >> 24) & 0xff;
+    hdr[5] = n & 0xff;
+    hdr[6] = (n >> 8) & 0xff;
+    if (fwrite(hdr, TRACE_HDSZ, 1, cp->fp) != 1 ||
+	fwrite(buf, 1, n, cp->fp) != n)
+      return -1;
+    buf += n;
+    bsz -= n;
+    dt = 0;
+  } while (bsz > 0);
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Wait for input on the captured transport.
+ *****************************************************************************/
+static int capture_wait(transport_t *tp, const struct timespec *dlp) {
+  return tp->inner->ops->wait(tp->inner, dlp);
+}
+
+
+/*****************************************************************************
+ Read from the captured transport, recording the data read.
+ *****************************************************************************/
+static ssize_t capture_read(transport_t *tp, char *buf, size_t bsz) {
+  ssize_t b;
+
+  b = tp->inner->ops->read(tp->inner, buf, bsz);
+  tp->eof = tp->inner->eof;
+  if (b > 0)
+    capture_record(tp->priv, TRACE_READ, buf, b);
+
+  return b;
+}
+
+
+/*****************************************************************************
+ Write to the captured transport, recording the data written.
+ *****************************************************************************/
+static ssize_t capture_write(transport_t *tp, const char *buf, size_t bsz) {
+  ssize_t b;
+
+  b = tp->inner->ops->write(tp->inner, buf, bsz);
+  if (b > 0)
+    capture_record(tp->priv, TRACE_WRITE, buf, b);
+
+  return b;
+}
+
+
+/*****************************************************************************
+ Close the capture trace file. The captured transport is closed by
+ transport_close.
+ *****************************************************************************/
+static int capture_close(transport_t *tp) {
+  capture_t *cp = tp->priv;
+  int rv;
+
+  rv = (ferror(cp->fp) | fclose(cp->fp))?-1:0;
+  free(cp);
+
+  return rv;
+}
+
+
+/*****************************************************************************
+ Change the line speed of the captured transport.
+ *****************************************************************************/
+static int capture_speed(transport_t *tp, unsigned int speed) {
+  return transport_speed(tp->inner, speed);
+}
+
+
+/*****************************************************************************
+ Set the input watermark of the captured transport.
+ *****************************************************************************/
+static int capture_watermark(transport_t *tp, unsigned int n) {
+  return transport_watermark(tp->inner, n);
+}
+
+
+static const transport_ops_t capture_transport = {
+  "capture", NULL, capture_wait, capture_read, capture_write, capture_close,
+  capture_speed, capture_watermark
+};
+
+
+/*****************************************************************************
+ Record all traffic on transport tp to trace file fnam. Returns a
+ transport wrapping tp, which is closed when the returned transport is
+ closed, or NULL, with errno set, on failure.
+ *****************************************************************************/
+transport_t *trace_capture(transport_t *tp, const char *fnam) {
+  capture_t *cp;
+  transport_t *ctp;
+  int errsv;
+
+  if ((cp = malloc(sizeof(capture_t))) == NULL)
+    return NULL;
+  if ((cp->fp = fopen(fnam, "wb")) == NULL) {
+    errsv = errno;
+    free(cp);
+    errno = errsv;
+    return NULL;
+  }
+  if (fwrite(TRACE_MAGIC, TRACE_MGSZ, 1, cp->fp) != 1 ||
+      (ctp = transport_wrap(&capture_transport, tp, cp)) == NULL) {
+    errsv = errno;
+    fclose(cp->fp);
+    free(cp);
+    errno = errsv;
+    return NULL;
+  }
+  clock_gettime(DEADLINE_CLOCK, &cp->last);
+
+  return ctp;
+}
+
+
+/*****************************************************************************
+ Advance to the next record in the trace containing read data. Reads
+ following a write record are not made available until the program
+ has performed a corresponding write, so that responses are never
+ delivered before the command that elicited them.
+ *****************************************************************************/
+static void replay_next(transport_t *tp) {
+  replay_t *rp = tp->priv;
+  const unsigned char *hp;
+  unsigned long dt;
+  size_t n;
+
+  while (rp->rdn == 0 && rp->tpos + TRACE_HDSZ <= rp->tsz) {
+    hp = rp->trc + rp->tpos;
+    dt = hp[1] | hp[2] << 8 | hp[3] << 16 | (unsigned long)hp[4] << 24;
+    n = hp[5] | hp[6] << 8;
+    /* Treat a truncated record as the end of the trace */
+    if (rp->tpos + TRACE_HDSZ + n > rp->tsz) {
+      rp->tpos = rp->tsz;
+      break;
+    }
+    if (hp[0] == TRACE_WRITE) {
+      if (rp->nwt >= rp->nwp)
+	return;
+      rp->nwt++;
+      /* Subsequent reads are timed relative to the program's write */
+      rp->due = rp->wrtm;
+    } else {
+      rp->due.tv_sec += dt / 1000000L;
+      rp->due.tv_nsec += (dt % 1000000L) * 1000L;
+      if (rp->due.tv_nsec >= 1000000000L) {
+	rp->due.tv_sec++;
+	rp->due.tv_nsec -= 1000000000L;
+      }
+      rp->rdp = (const char *)hp + TRACE_HDSZ;
+      rp->rdn = n;
+    }
+    rp->tpos += TRACE_HDSZ + n;
+  }
+
+  if (rp->rdn == 0 && rp->tpos + TRACE_HDSZ > rp->tsz)
+    tp->eof = 1;
+}
+
+
+/*****************************************************************************
+ Compare times tsp0 and tsp1, returning a negative, zero, or positive
+ value as for strcmp.
+ *****************************************************************************/
+static int timespec_cmp(const struct timespec *tsp0,
+			const struct timespec *tsp1) {
+  if (tsp0->tv_sec != tsp1->tv_sec)
+    return (tsp0->tv_sec < tsp1->tv_sec)?-1:1;
+  if (tsp0->tv_nsec != tsp1->tv_nsec)
+    return (tsp0->tv_nsec < tsp1->tv_nsec)?-1:1;
+  return 0;
+}
+
+
+/*****************************************************************************
+ Open trace file addrs for replay.
+ *****************************************************************************/
+static int replay_open_trace(transport_t *tp, const char *addrs, short fast) {
+  replay_t *rp;
+  struct stat st;
+  ssize_t b;
+  size_t n;
+  int errsv;
+
+  if ((tp->fd = open(addrs, O_RDONLY)) < 0)
+    return -1;
+  if ((rp = malloc(sizeof(replay_t))) == NULL) {
+    close(tp->fd);
+    return -1;
+  }
+  memset(rp, 0, sizeof(replay_t));
+  rp->fast = fast;
+  if (fstat(tp->fd, &st) < 0 || (rp->trc = malloc(st.st_size+1)) == NULL)
+    goto error;
+  rp->tsz = st.st_size;
+  for (n = 0; n < rp->tsz; n += b) {
+    if ((b = read(tp->fd, rp->trc + n, rp->tsz - n)) <= 0) {
+      if (b == 0)
+	errno = EIO;
+      goto error;
+    }
+  }
+  if (rp->tsz < TRACE_MGSZ || memcmp(rp->trc, TRACE_MAGIC, TRACE_MGSZ) != 0) {
+    errno = EINVAL;
+    goto error;
+  }
+  close(tp->fd);
+  tp->fd = -1;
+
+  rp->tpos = TRACE_MGSZ;
+  clock_gettime(DEADLINE_CLOCK, &rp->due);
+  tp->priv = rp;
+  return 0;
+
+ error:
+  errsv = errno;
+  close(tp->fd);
+  free(rp->trc);
+  free(rp);
+  errno = errsv;
+  return -1;
+}
+
+
+/*****************************************************************************
+ Open trace file addrs for replay at recorded speed.
+ *****************************************************************************/
+static int replay_open(transport_t *tp, const char *addrs,
+		       unsigned int arg UNUSED) {
+  return replay_open_trace(tp, addrs, 0);
+}
+
+
+/*****************************************************************************
+ Open trace file addrs for replay as fast as possible.
+ *****************************************************************************/
+static int replay_fast_open(transport_t *tp, const char *addrs,
+			    unsigned int arg UNUSED) {
+  return replay_open_trace(tp, addrs, 1);
+}
+
+
+/*****************************************************************************
+ Wait until deadline dlp for replayed input. When replaying at
+ recorded speed, a wait for input that is not available before the
+ deadline, including at the end of the trace, sleeps until the
+ deadline, as for a silent device. When replaying as fast as possible,
+ it returns immediately.
+ *****************************************************************************/
+static int replay_wait(transport_t *tp, const struct timespec *dlp) {
+  replay_t *rp = tp->priv;
+
+  replay_next(tp);
+  if (rp->rdn == 0) {
+    if (!rp->fast)
+      deadline_sleep(dlp);
+    return 0;
+  }
+  if (!rp->fast) {
+    if (timespec_cmp(&rp->due, dlp) > 0) {
+      deadline_sleep(dlp);
+      return 0;
+    }
+    deadline_sleep(&rp->due);
+  }
+
+  return 1;
+}
+
+
+/*****************************************************************************
+ Read at most bsz bytes of replayed input that has become available.
+ *****************************************************************************/
+static ssize_t replay_read(transport_t *tp, char *buf, size_t bsz) {
+  replay_t *rp = tp->priv;
+  struct timespec now;
+  size_t n;
+
+  replay_next(tp);
+  if (rp->rdn == 0)
+    return 0;
+  if (!rp->fast) {
+    clock_gettime(DEADLINE_CLOCK, &now);
+    if (timespec_cmp(&now, &rp->due) < 0)
+      return 0;
+  }
+
+  n = (bsz < rp->rdn)?bsz:rp->rdn;
+  memcpy(buf, rp->rdp, n);
+  rp->rdp += n;
+  rp->rdn -= n;
+
+  return n;
+}
+
+
+/*****************************************************************************
+ Accept bsz bytes written to the replay transport, releasing the
+ replayed response to the corresponding recorded write.
+ *****************************************************************************/
+static ssize_t replay_write(transport_t *tp, const char *buf UNUSED,
+			    size_t bsz) {
+  replay_t *rp = tp->priv;
+
+  rp->nwp++;
+  clock_gettime(DEADLINE_CLOCK, &rp->wrtm);
+
+  return bsz;
+}
+
+
+/*****************************************************************************
+ Close replay transport.
+ *****************************************************************************/
+static int replay_close(transport_t *tp) {
+  replay_t *rp = tp->priv;
+
+  free(rp->trc);
+  free(rp);
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Accept a line speed change, which has no effect on replay.
+ *****************************************************************************/
+static int replay_speed(transport_t *tp UNUSED, unsigned int speed UNUSED) {
+  return 0;
+}
+
+
+const transport_ops_t replay_transport = {
+  "replay", replay_open, replay_wait, replay_read, replay_write, replay_close,
+  replay_speed, NULL
+};
+
+const transport_ops_t replay_fast_transport = {
+  "replay-fast", replay_fast_open, replay_wait, replay_read, replay_write,
+  replay_close, replay_speed, NULL
+};
@@ -0,0 +1,39 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include "transport.h"
+
+/* A trace file consists of the magic string TRACE_MAGIC followed by a
+   sequence of records, each consisting of a direction byte
+   (TRACE_READ or TRACE_WRITE), the time in microseconds since the
+   previous record as a 32 bit little-endian integer, the data length
+   as a 16 bit little-endian integer, and the data itself. */
+#define TRACE_MAGIC "RTKTRC1\n"
+#define TRACE_MGSZ 8
+#define TRACE_HDSZ 7
+#define TRACE_READ 'R'
+#define TRACE_WRITE 'W'
+
+extern const transport_ops_t replay_transport;
+extern const transport_ops_t replay_fast_transport;
+
+transport_t *trace_capture(transport_t *tp, const char *fnam);
+
+#endif
@@ -0,0 +1,436 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <errno.h>
+#include "serial.h"
+#include "transport.h"
+#include "trace.h"
+
+
+/*****************************************************************************
+ Wait until deadline dlp for input on the file descriptor of transport
+ tp.
+ *****************************************************************************/
+static int fd_wait(transport_t *tp, const struct timespec *dlp) {
+  struct pollfd pfd;
+  int n;
+
+  pfd.fd = tp->fd;
+  pfd.events = POLLIN;
+  do {
+    n = poll(&pfd, 1, deadline_remaining(dlp));
+  } while (n < 0 && errno == EINTR);
+
+  return (n > 0)?1:n;
+}
+
+
+/*****************************************************************************
+ Read at most bsz bytes from the file descriptor of transport tp.
+ *****************************************************************************/
+static ssize_t fd_read(transport_t *tp, char *buf, size_t bsz) {
+  ssize_t b;
+
+  b = read(tp->fd, buf, bsz);
+  /* If read returns -1 but errno is EAGAIN, set read count to zero */
+  if (b < 0 && errno == EAGAIN)
+    b = 0;
+
+  return b;
+}
+
+
+/*****************************************************************************
+ Write bsz bytes to the file descriptor of transport tp.
+ *****************************************************************************/
+static ssize_t fd_write(transport_t *tp, const char *buf, size_t bsz) {
+  return write(tp->fd, buf, bsz);
+}
+
+
+/*****************************************************************************
+ Open serial device addrs at line speed arg.
+ *****************************************************************************/
+static int serial_open(transport_t *tp, const char *addrs, unsigned int arg) {
+  if ((tp->fd = dev_open(addrs, &tp->tios)) < 0)
+    return -1;
+  /* dev_config_serial closes the device on failure */
+  return dev_config_serial(tp->fd, arg, &tp->tios);
+}
+
+
+/*****************************************************************************
+ Close serial device, restoring its pre-connection state.
+ *****************************************************************************/
+static int serial_close(transport_t *tp) {
+  return dev_close(tp->fd, &tp->tios);
+}
+
+
+/*****************************************************************************
+ Change serial device line speed.
+ *****************************************************************************/
+static int serial_speed(transport_t *tp, unsigned int speed) {
+  return dev_set_speed(tp->fd, speed);
+}
+
+
+/*****************************************************************************
+ Set serial device input watermark.
+ *****************************************************************************/
+static int serial_watermark(transport_t *tp, unsigned int n) {
+  return dev_set_watermark(tp->fd, n);
+}
+
+
+const transport_ops_t serial_transport = {
+  "serial", serial_open, fd_wait, fd_read, fd_write, serial_close,
+  serial_speed, serial_watermark
+};
+
+
+#if ENABLE_LINUX_BT-0
+/*****************************************************************************
+ Open an RFCOMM connection to bluetooth address addrs on channel arg.
+ *****************************************************************************/
+static int rfcomm_open(transport_t *tp, const char *addrs, unsigned int arg) {
+  if ((tp->fd = bt_open(addrs, arg)) < 0)
+    return -1;
+  return 0;
+}
+
+
+/*****************************************************************************
+ Close an RFCOMM connection.
+ *****************************************************************************/
+static int rfcomm_close(transport_t *tp) {
+  return bt_close(tp->fd);
+}
+
+
+const transport_ops_t rfcomm_transport = {
+  "rfcomm", rfcomm_open, fd_wait, fd_read, fd_write, rfcomm_close, NULL,
+  NULL
+};
+#endif /* ENABLE_LINUX_BT */
+
+
+/*****************************************************************************
+ Open a TCP connection to addrs, in the form host:port, as provided by
+ a serial-to-network bridge such as ser2net.
+ *****************************************************************************/
+static int tcp_open(transport_t *tp, const char *addrs,
+		    unsigned int arg UNUSED) {
+  struct addrinfo hints, *aip, *ap;
+  char host[256];
+  const char *port;
+  int sfl, one = 1;
+
+  if ((port = strrchr(addrs, ':')) == NULL || port == addrs ||
+      port - addrs >= (int)sizeof(host)) {
+    errno = EINVAL;
+    return -1;
+  }
+  memcpy(host, addrs, port - addrs);
+  host[port - addrs] = '\0';
+  port++;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(host, port, &hints, &aip) != 0) {
+    errno = EHOSTUNREACH;
+    return -1;
+  }
+
+  tp->fd = -1;
+  for (ap = aip; ap != NULL; ap = ap->ai_next) {
+    if ((tp->fd = socket(ap->ai_family, ap->ai_socktype,
+			 ap->ai_protocol)) < 0)
+      continue;
+    if (connect(tp->fd, ap->ai_addr, ap->ai_addrlen) == 0)
+      break;
+    close(tp->fd);
+    tp->fd = -1;
+  }
+  freeaddrinfo(aip);
+  if (tp->fd < 0)
+    return -1;
+
+  /* Commands are short, so disable Nagle's algorithm to avoid delaying
+     them, and make reads non-blocking as for the other transports */
+  setsockopt(tp->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if ((sfl = fcntl(tp->fd, F_GETFL, 0)) < 0 ||
+      fcntl(tp->fd, F_SETFL, sfl | O_NONBLOCK) < 0) {
+    close(tp->fd);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Read at most bsz bytes from a TCP connection, recording connection
+ closure by the peer.
+ *****************************************************************************/
+static ssize_t tcp_read(transport_t *tp, char *buf, size_t bsz) {
+  ssize_t b;
+
+  b = read(tp->fd, buf, bsz);
+  if (b == 0)
+    tp->eof = 1;
+  else if (b < 0 && errno == EAGAIN)
+    b = 0;
+
+  return b;
+}
+
+
+/*****************************************************************************
+ Close a TCP connection.
+ *****************************************************************************/
+static int tcp_close(transport_t *tp) {
+  return close(tp->fd);
+}
+
+
+const transport_ops_t tcp_transport = {
+  "tcp", tcp_open, fd_wait, tcp_read, fd_write, tcp_close, NULL, NULL
+};
+
+
+/*****************************************************************************
+ Open pseudo-terminal addrs. The line is configured as for a serial
+ device, except that the line speed is left unchanged.
+ *****************************************************************************/
+static int pty_open(transport_t *tp, const char *addrs,
+		    unsigned int arg UNUSED) {
+  if ((tp->fd = dev_open(addrs, &tp->tios)) < 0)
+    return -1;
+  return dev_config_serial(tp->fd, 0, &tp->tios);
+}
+
+
+/* Line speed changes are accepted, although they have no effect on a
+   pseudo-terminal, so that they can be tested with an emulator */
+const transport_ops_t pty_transport = {
+  "pty", pty_open, fd_wait, fd_read, fd_write, serial_close, serial_speed,
+  serial_watermark
+};
+
+
+/*****************************************************************************
+ Open file addrs containing raw logger output. Reads are satisfied
+ from the file as fast as possible, and writes are discarded.
+ *****************************************************************************/
+static int file_open(transport_t *tp, const char *addrs,
+		     unsigned int arg UNUSED) {
+  if ((tp->fd = open(addrs, O_RDONLY)) < 0)
+    return -1;
+  return 0;
+}
+
+
+/*****************************************************************************
+ Input is available until the end of file is reached, after which all
+ waits time out immediately.
+ *****************************************************************************/
+static int file_wait(transport_t *tp, const struct timespec *dlp UNUSED) {
+  return (tp->eof)?0:1;
+}
+
+
+/*****************************************************************************
+ Read at most bsz bytes from file, recording end of file.
+ *****************************************************************************/
+static ssize_t file_read(transport_t *tp, char *buf, size_t bsz) {
+  ssize_t b;
+
+  b = read(tp->fd, buf, bsz);
+  if (b == 0)
+    tp->eof = 1;
+  return b;
+}
+
+
+/*****************************************************************************
+ Discard bsz bytes written to file transport.
+ *****************************************************************************/
+static ssize_t file_write(transport_t *tp UNUSED,
+			  const char *buf UNUSED,
+			  size_t bsz) {
+  return bsz;
+}
+
+
+/*****************************************************************************
+ Close file transport.
+ *****************************************************************************/
+static int file_close(transport_t *tp) {
+  return close(tp->fd);
+}
+
+
+const transport_ops_t file_transport = {
+  "file", file_open, file_wait, file_read, file_write, file_close, NULL,
+  NULL
+};
+
+
+/*****************************************************************************
+ Determine the transport backend for device specification devs, which
+ is either a serial device path or one of tcp:host:port, pty:path,
+ file:path, replay:path, or replay-fast:path. On return, addrs points
+ to the backend-specific address.
+ *****************************************************************************/
+const transport_ops_t *transport_lookup(const char *devs, const char **addrs) {
+  static const struct {
+    const char *prfx;
+    const transport_ops_t *ops;
+  } scheme[] = {{"tcp:", &tcp_transport}, {"pty:", &pty_transport},
+		{"file:", &file_transport}, {"replay:", &replay_transport},
+		{"replay-fast:", &replay_fast_transport}};
+  size_t n;
+
+  for (n = 0; n < sizeof(scheme)/sizeof(scheme[0]); n++) {
+    if (strncmp(devs, scheme[n].prfx, strlen(scheme[n].prfx)) == 0) {
+      *addrs = devs + strlen(scheme[n].prfx);
+      return scheme[n].ops;
+    }
+  }
+  *addrs = devs;
+  return &serial_transport;
+}
+
+
+/*****************************************************************************
+ Open a connection to addrs using transport backend ops. Returns NULL,
+ with errno set, on failure.
+ *****************************************************************************/
+transport_t *transport_open(const transport_ops_t *ops, const char *addrs,
+			    unsigned int arg) {
+  transport_t *tp;
+  int errsv;
+
+  if ((tp = malloc(sizeof(transport_t))) == NULL)
+    return NULL;
+  memset(tp, 0, sizeof(transport_t));
+  tp->ops = ops;
+  tp->fd = -1;
+  tp->arg = arg;
+  tp->rxwm = 1;
+  strncpy(tp->addrs, addrs, sizeof(tp->addrs)-1);
+
+  if (ops->open(tp, addrs, arg) < 0) {
+    errsv = errno;
+    free(tp);
+    errno = errsv;
+    return NULL;
+  }
+
+  return tp;
+}
+
+
+/*****************************************************************************
+ Create a transport that passes traffic for transport itp through
+ backend ops, which has private data priv. The wrapping transport
+ takes ownership of itp, which is closed when it is closed. Returns
+ NULL, with errno set, on failure, in which case itp is unaffected.
+ *****************************************************************************/
+transport_t *transport_wrap(const transport_ops_t *ops, transport_t *itp,
+			    void *priv) {
+  transport_t *tp;
+
+  if ((tp = malloc(sizeof(transport_t))) == NULL)
+    return NULL;
+  memset(tp, 0, sizeof(transport_t));
+  tp->ops = ops;
+  tp->fd = itp->fd;
+  tp->arg = itp->arg;
+  tp->rxwm = 1;
+  strcpy(tp->addrs, itp->addrs);
+  tp->priv = priv;
+  tp->inner = itp;
+
+  return tp;
+}
+
+
+/*****************************************************************************
+ Change the line speed of transport tp, after pending output has been
+ transmitted. Returns -1, with errno set to ENOTSUP, if the transport
+ does not support line speed changes.
+ *****************************************************************************/
+int transport_speed(transport_t *tp, unsigned int speed) {
+  if (tp->ops->speed == NULL) {
+    errno = ENOTSUP;
+    return -1;
+  }
+  if (tp->ops->speed(tp, speed) < 0)
+    return -1;
+  tp->arg = speed;
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Set the input watermark of transport tp, so that waits for input do
+ not return until at least n bytes are available, or the deadline
+ expires. This is only a hint, which is ignored by transports that do
+ not support it, and the device is only reconfigured when the value
+ changes. The caller must ensure that at least n bytes are expected,
+ since otherwise each wait will run until its deadline.
+ *****************************************************************************/
+int transport_watermark(transport_t *tp, unsigned int n) {
+  if (n < 1)
+    n = 1;
+  else if (n > TRANSPORT_MXWM)
+    n = TRANSPORT_MXWM;
+  if (n == tp->rxwm || tp->ops->watermark == NULL)
+    return 0;
+  if (tp->ops->watermark(tp, n) < 0)
+    return -1;
+  tp->rxwm = n;
+
+  return 0;
+}
+
+
+/*****************************************************************************
+ Close transport tp and free associated resources.
+ *****************************************************************************/
+int transport_close(transport_t *tp) {
+  int rv;
+
+  rv = tp->ops->close(tp);
+  if (tp->inner != NULL && transport_close(tp->inner) < 0)
+    rv = -1;
+  free(tp);
+  return rv;
+}
@@ -0,0 +1,95 @@
+/******************************************************************************
+
+    Copyright © 2026 Brendt Wohlberg
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of version 2 of the GNU General Public License at
+    http://www.gnu.org/licenses/gpl-2.0.txt.
+
+    This program is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    Most recent modification: 17 October 2026
+
+******************************************************************************/
+
+#ifndef _TRANSPORT_H
+#define _TRANSPORT_H
+
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+#include <termios.h>
+
+#ifdef __GNUC__
+#define UNUSED __attribute__((unused))
+#else
+#define UNUSED
+#endif
+
+/* Size of the input buffer, which must exceed the length of the
+   longest logger response */
+#define TRANSPORT_IBSZ 4096
+
+/* Maximum input watermark. On Linux, a terminal read returns at most
+   64 bytes when VMIN exceeds 64, so larger values would increase,
+   rather than reduce, the number of reads */
+#define TRANSPORT_MXWM 64
+
+typedef struct transport_s transport_t;
+
+/* Operations implemented by each transport backend. The wait
+   operation blocks until input is available or the absolute deadline
+   dlp expires, returning 1, 0, or -1 on error. The read operation
+   does not block, and returns 0 if no input is available. The speed
+   operation, which changes the line speed after pending output has
+   been transmitted, is NULL if not supported. The watermark
+   operation, also optional, sets the number of bytes of input that
+   must be available before the wait operation reports input. */
+typedef struct {
+  const char *name;
+  int (*open)(transport_t *tp, const char *addrs, unsigned int arg);
+  int (*wait)(transport_t *tp, const struct timespec *dlp);
+  ssize_t (*read)(transport_t *tp, char *buf, size_t bsz);
+  ssize_t (*write)(transport_t *tp, const char *buf, size_t bsz);
+  int (*close)(transport_t *tp);
+  int (*speed)(transport_t *tp, unsigned int speed);
+  int (*watermark)(transport_t *tp, unsigned int n);
+} transport_ops_t;
+
+struct transport_s {
+  const transport_ops_t *ops;
+  int fd;
+  unsigned int arg;   /* line speed or channel number */
+  char addrs[256];    /* device path or address */
+  short int eof;      /* end of input reached */
+  void *priv;         /* backend private data */
+  transport_t *inner; /* transport wrapped by this one, or NULL */
+  unsigned int rxwm;  /* input watermark */
+  char ibuf[TRANSPORT_IBSZ]; /* input buffer */
+  size_t ibrp;        /* input buffer read position */
+  size_t ibwp;        /* input buffer write position */
+  size_t rxexp;       /* expected input bytes not yet received */
+  struct termios tios; /* terminal settings before the device was opened */
+};
+
+extern const transport_ops_t serial_transport;
+#if ENABLE_LINUX_BT-0
+extern const transport_ops_t rfcomm_transport;
+#endif /* ENABLE_LINUX_BT */
+extern const transport_ops_t tcp_transport;
+extern const transport_ops_t pty_transport;
+extern const transport_ops_t file_transport;
+
+const transport_ops_t *transport_lookup(const char *devs, const char **addrs);
+transport_t *transport_open(const transport_ops_t *ops, const char *addrs,
+			    unsigned int arg);
+transport_t *transport_wrap(const transport_ops_t *ops, transport_t *itp,
+			    void *priv);
+int transport_speed(transport_t *tp, unsigned int speed);
+int transport_watermark(transport_t *tp, unsigned int n);
+int transport_close(transport_t *tp);
+
+#endif